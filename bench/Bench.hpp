@@ -0,0 +1,16 @@
+#pragma once
+#include <klay/Klay.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchScene {
+	std::string name;
+	// parameters of the scene, reported alongside the results
+	std::vector<std::pair<std::string, int>> params;
+	Klay::PxRect viewport;
+	std::function<std::shared_ptr<Klay::Element>()> build;
+};
+
+std::vector<BenchScene> MakeBenchScenes(int scale);
@@ -0,0 +1,261 @@
+#include <klay/Klay.hpp>
+
+#include "./Bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef KLAY_BENCH_REVISION
+#define KLAY_BENCH_REVISION "unknown"
+#endif
+
+// heap tracking, every allocation is prefixed with its size
+namespace {
+	constexpr size_t alloc_header = alignof(std::max_align_t);
+
+	std::atomic<size_t> allocation_count = 0;
+	std::atomic<size_t> live_bytes = 0;
+	std::atomic<size_t> peak_bytes = 0;
+
+	void ResetPeak() {
+		peak_bytes = live_bytes.load();
+	}
+}
+
+void* operator new(std::size_t size) {
+	auto* block = static_cast<unsigned char*>(std::malloc(size + alloc_header));
+	if (!block) {
+		throw std::bad_alloc{};
+	}
+	std::memcpy(block, &size, sizeof(size));
+	++allocation_count;
+	const auto live = live_bytes += size;
+	auto peak = peak_bytes.load();
+	while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {}
+	return block + alloc_header;
+}
+
+void operator delete(void* ptr) noexcept {
+	if (!ptr) {
+		return;
+	}
+	auto* block = static_cast<unsigned char*>(ptr) - alloc_header;
+	size_t size;
+	std::memcpy(&size, block, sizeof(size));
+	live_bytes -= size;
+	std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	operator delete(ptr);
+}
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+	using namespace Klay;
+
+	struct Measurement {
+		double median_ns = 0;
+		double min_ns = 0;
+		double allocations = 0;
+	};
+
+	// runs setup untimed, then times pass, iterations times
+	template<typename Setup, typename Pass>
+	Measurement Measure(int iterations, Setup&& setup, Pass&& pass) {
+		std::vector<double> samples;
+		size_t allocations = 0;
+		for (int i = 0; i < iterations; ++i) {
+			setup();
+			const auto allocations_before = allocation_count.load();
+			const auto start = Clock::now();
+			pass();
+			const auto end = Clock::now();
+			allocations += allocation_count.load() - allocations_before;
+			samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+		}
+		std::sort(samples.begin(), samples.end());
+		return Measurement{
+			samples[samples.size() / 2],
+			samples.front(),
+			static_cast<double>(allocations) / iterations,
+		};
+	}
+
+	void MarkTreeDirty(Element& element) {
+		element.MarkDirty();
+		for (auto& child : element) {
+			MarkTreeDirty(*child);
+		}
+	}
+
+	size_t CountElements(const Element& element) {
+		size_t count = 1;
+		for (const auto& child : element) {
+			count += CountElements(*child);
+		}
+		return count;
+	}
+
+	Element& LastLeaf(Element& element) {
+		return element.NumChildren() ? LastLeaf(*element.children.back()) : element;
+	}
+
+	void PrintMeasurement(
+		std::ostream& os,
+		const char* name,
+		const Measurement& measurement,
+		size_t elements
+	) {
+		os << "\"" << name << "\": {"
+			<< "\"median_ns\": " << measurement.median_ns << ", "
+			<< "\"min_ns\": " << measurement.min_ns << ", "
+			<< "\"ns_per_element\": " << measurement.median_ns / elements << ", "
+			<< "\"allocations_per_pass\": " << measurement.allocations
+			<< "}";
+	}
+
+	void RunScene(
+		std::ostream& os,
+		const BenchScene& scene,
+		int iterations,
+		ThreadPool& pool
+	) {
+		const auto build_start_bytes = live_bytes.load();
+		ResetPeak();
+
+		std::shared_ptr<Element> root;
+		const auto build = Measure(
+			iterations,
+			[&] { root.reset(); },
+			[&] { root = scene.build(); }
+		);
+		const auto elements = CountElements(*root);
+
+		const auto min_size = Measure(
+			iterations,
+			[&] { MarkTreeDirty(*root); },
+			[&] { root->ComputeMinSize(); }
+		);
+
+		const auto layout = Measure(
+			iterations,
+			[&] { MarkTreeDirty(*root); root->ComputeMinSize(); },
+			[&] { root->ComputeTreeLayout(scene.viewport); }
+		);
+
+		const auto peak_element_bytes = peak_bytes.load() - build_start_bytes;
+
+		const auto parallel_layout = Measure(
+			iterations,
+			[&] { MarkTreeDirty(*root); root->ComputeMinSize(); },
+			[&] { root->ComputeTreeLayout(scene.viewport, pool); }
+		);
+
+		const auto clean_layout = Measure(
+			iterations,
+			[&] {},
+			[&] { root->ComputeTreeLayout(scene.viewport); }
+		);
+
+		auto& leaf = LastLeaf(*root);
+		const auto leaf_relayout = Measure(
+			iterations,
+			[&] { leaf.MarkDirty(); },
+			[&] { root->ComputeTreeLayout(scene.viewport); }
+		);
+
+		ResetPeak();
+		const auto tree_start_bytes = live_bytes.load();
+		auto tree = LayoutTree::FromElement(*root);
+		const auto tree_layout = Measure(
+			iterations,
+			[&] {},
+			[&] { tree.ComputeLayout(scene.viewport); }
+		);
+		const auto peak_tree_bytes = peak_bytes.load() - tree_start_bytes;
+
+		os << "    {\"scene\": \"" << scene.name << "\", \"params\": {";
+		for (size_t i = 0; i < scene.params.size(); ++i) {
+			os << (i ? ", " : "") << "\"" << scene.params[i].first << "\": " << scene.params[i].second;
+		}
+		os << "}, \"elements\": " << elements << ",\n      ";
+		PrintMeasurement(os, "build", build, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "min_size", min_size, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "layout", layout, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "parallel_layout", parallel_layout, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "clean_relayout", clean_layout, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "leaf_relayout", leaf_relayout, elements);
+		os << ",\n      ";
+		PrintMeasurement(os, "layout_tree", tree_layout, elements);
+		os << ",\n      \"peak_heap_bytes\": {"
+			<< "\"elements\": " << peak_element_bytes << ", "
+			<< "\"layout_tree\": " << peak_tree_bytes
+			<< "}}";
+	}
+
+	void PrintUsage() {
+		std::cerr
+			<< "Usage: KLayBench [--iterations N] [--scale N] [--scene NAME]\n"
+			<< "Prints layout timings of synthetic scenes as JSON\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	int iterations = 20;
+	int scale = 1;
+	std::string only_scene;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--iterations" && i + 1 < argc) {
+			iterations = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "--scale" && i + 1 < argc) {
+			scale = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "--scene" && i + 1 < argc) {
+			only_scene = argv[++i];
+		}
+		else {
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	ThreadPool pool;
+
+	auto& os = std::cout;
+	os << "{\n  \"revision\": \"" << KLAY_BENCH_REVISION << "\",\n"
+		<< "  \"iterations\": " << iterations << ",\n"
+		<< "  \"scale\": " << scale << ",\n"
+		<< "  \"threads\": " << pool.NumThreads() + 1 << ",\n"
+		<< "  \"results\": [\n";
+
+	bool first = true;
+	for (const auto& scene : MakeBenchScenes(scale)) {
+		if (!only_scene.empty() && scene.name != only_scene) {
+			continue;
+		}
+		if (!first) {
+			os << ",\n";
+		}
+		first = false;
+		RunScene(os, scene, iterations, pool);
+	}
+
+	os << "\n  ]\n}\n";
+	return 0;
+}
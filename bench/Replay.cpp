@@ -0,0 +1,105 @@
+#include <klay/Klay.hpp>
+#include <klay/LayoutTrace.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef KLAY_BENCH_REVISION
+#define KLAY_BENCH_REVISION "unknown"
+#endif
+
+namespace {
+	using namespace Klay;
+
+	const char* KindName(LayoutTraceCallKind kind) {
+		switch (kind) {
+			case LayoutTraceCallKind::Layout: return "layout";
+			case LayoutTraceCallKind::TreeLayout: return "tree_layout";
+			case LayoutTraceCallKind::ParallelTreeLayout: return "parallel_tree_layout";
+			case LayoutTraceCallKind::DamageTreeLayout: return "damage_tree_layout";
+		}
+		return "unknown";
+	}
+
+	void PrintUsage() {
+		std::cerr
+			<< "Usage: KLayReplay TRACE [--iterations N]\n"
+			<< "Replays a trace from StopLayoutTrace and prints the timing\n"
+			<< "of each layout call as JSON\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	int iterations = 20;
+	std::string path;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--iterations" && i + 1 < argc) {
+			iterations = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (path.empty() && !arg.starts_with("--")) {
+			path = arg;
+		}
+		else {
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (path.empty()) {
+		PrintUsage();
+		return 1;
+	}
+
+	std::ifstream file{path, std::ios::binary};
+	if (!file) {
+		std::cerr << "Cannot open " << path << "\n";
+		return 1;
+	}
+	const std::vector<char> bytes{std::istreambuf_iterator<char>{file}, {}};
+	const std::span trace{reinterpret_cast<const std::byte*>(bytes.data()), bytes.size()};
+
+	ThreadPool pool;
+
+	// each iteration replays the whole trace on new elements,
+	// samples[call] holds the times of one call
+	std::vector<LayoutTraceCall> calls;
+	std::vector<std::vector<double>> samples;
+	for (int i = 0; i < iterations; ++i) {
+		auto replayed = ReplayLayoutTrace(trace, &pool);
+		if (!replayed) {
+			std::cerr << "Not a trace of this version: " << path << "\n";
+			return 1;
+		}
+		calls = std::move(*replayed);
+		samples.resize(calls.size());
+		for (size_t call = 0; call < calls.size(); ++call) {
+			samples[call].push_back(static_cast<double>(calls[call].replay_time.count()));
+		}
+	}
+
+	auto& os = std::cout;
+	os << "{\n  \"revision\": \"" << KLAY_BENCH_REVISION << "\",\n"
+		<< "  \"iterations\": " << iterations << ",\n"
+		<< "  \"calls\": [\n";
+	for (size_t call = 0; call < calls.size(); ++call) {
+		auto& times = samples[call];
+		std::sort(times.begin(), times.end());
+		const auto& rect = calls[call].rect;
+		os << "    {\"kind\": \"" << KindName(calls[call].kind) << "\", "
+			<< "\"element\": " << calls[call].element << ", "
+			<< "\"rect\": [" << rect.X().value << ", " << rect.Y().value << ", "
+			<< rect.Width().value << ", " << rect.Height().value << "], "
+			<< "\"recorded_ns\": " << calls[call].recorded_time.count() << ", "
+			<< "\"median_ns\": " << times[times.size() / 2] << ", "
+			<< "\"min_ns\": " << times.front() << "}"
+			<< (call + 1 < calls.size() ? ",\n" : "\n");
+	}
+	os << "  ]\n}\n";
+	return 0;
+}
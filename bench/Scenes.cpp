@@ -0,0 +1,267 @@
+#include "./Bench.hpp"
+
+using namespace Klay;
+
+namespace {
+	// a chain of flex containers, each with a single child
+	BenchScene DeepChain(int depth) {
+		return BenchScene{
+			"deep_chain",
+			{{"depth", depth}},
+			PxRect::FromWH(1920, 1080),
+			[depth] {
+				auto root = ElementBuilder{}
+					.Flex(Axis::Vertical)
+					.AlignItems(Align::Stretch)
+					.Build();
+				auto parent = root;
+				for (int i = 0; i < depth; ++i) {
+					parent = parent->AddChild(
+						ElementBuilder{}
+							.Flex(i % 2 ? Axis::Vertical : Axis::Horizontal)
+							.AlignItems(Align::Stretch)
+							.FlexGrow(1)
+							.PaddingPxLTRB(1, 1, 1, 1)
+							.Build()
+					);
+				}
+				return root;
+			},
+		};
+	}
+
+	// a single flex row with many growing leaves
+	BenchScene WideFlexRow(int width) {
+		return BenchScene{
+			"wide_flex_row",
+			{{"children", width}},
+			PxRect::FromWH(1920, 1080),
+			[width] {
+				auto root = ElementBuilder{}
+					.Flex()
+					.AlignItems(Align::Center)
+					.Gap(Px{1})
+					.Build();
+				for (int i = 0; i < width; ++i) {
+					root->AddChild(
+						ElementBuilder{}
+							.MinSize(Px{float(1 + i % 7)}, Px{float(10 + i % 13)})
+							.FlexGrow(float(i % 3))
+							.Build()
+					);
+				}
+				return root;
+			},
+		};
+	}
+
+	// a toolbar twice as wide as the window, whose items shrink
+	// by different factors so that many of them bottom out at their min size
+	BenchScene ShrinkToolbar(int items) {
+		return BenchScene{
+			"shrink_toolbar",
+			{{"items", items}},
+			PxRect::FromWH(1920, 40),
+			[items] {
+				auto root = ElementBuilder{}
+					.Flex()
+					.AlignItems(Align::Stretch)
+					.Gap(Px{1})
+					.Build();
+				const float item_width = 2.0f * 1920 / items;
+				for (int i = 0; i < items; ++i) {
+					root->AddChild(
+						ElementBuilder{}
+							.Width(Px{item_width * float(1 + i % 5)})
+							.MinSize(Px{item_width * 0.5f}, Px{24})
+							.FlexShrink(float(i % 7))
+							.Build()
+					);
+				}
+				return root;
+			},
+		};
+	}
+
+	// a wrapped flex of chips, like a long tag list
+	BenchScene WrappedChips(int chips) {
+		return BenchScene{
+			"wrapped_chips",
+			{{"chips", chips}},
+			PxRect::FromWH(1280, 1080),
+			[chips] {
+				auto root = ElementBuilder{}
+					.Flex()
+					.Wrap()
+					.Gap(Px{4})
+					.Build();
+				for (int i = 0; i < chips; ++i) {
+					root->AddChild(
+						ElementBuilder{}
+							.MinSize(Px{float(40 + i * 37 % 90)}, Px{24})
+							.FlexGrow(float(i % 5 == 0))
+							.Build()
+					);
+				}
+				return root;
+			},
+		};
+	}
+
+	// rows of panels, each holding a grid of leaves
+	BenchScene NestedMix(int panels, int grids_per_panel, int grid_size) {
+		return BenchScene{
+			"nested_flex_grid",
+			{
+				{"panels", panels},
+				{"grids_per_panel", grids_per_panel},
+				{"grid_size", grid_size},
+			},
+			PxRect::FromWH(1920, 1080),
+			[=] {
+				auto root = ElementBuilder{}
+					.Flex(Axis::Vertical)
+					.AlignItems(Align::Stretch)
+					.Gap(Px{4})
+					.Build();
+				for (int p = 0; p < panels; ++p) {
+					auto panel = root->AddChild(
+						ElementBuilder{}
+							.Flex()
+							.FlexGrow(1)
+							.JustifyContent(Justify::SpaceBetween)
+							.PaddingPxLTRB(4, 4, 4, 4)
+							.Build()
+					);
+					for (int g = 0; g < grids_per_panel; ++g) {
+						auto grid = panel->AddChild(
+							ElementBuilder{}
+								.Grid(grid_size, grid_size)
+								.Gap(Px{2})
+								.FlexGrow(1)
+								.Build()
+						);
+						for (int i = 0; i < grid_size * grid_size; ++i) {
+							grid->AddChild(
+								ElementBuilder{}.MinSize(Px{4}, Px{4}).Build()
+							);
+						}
+					}
+				}
+				return root;
+			},
+		};
+	}
+
+	// the same tree as nested_flex_grid, built in one pass
+	// with ElementTreeBuilder
+	BenchScene NestedMixBulk(int panels, int grids_per_panel, int grid_size) {
+		return BenchScene{
+			"nested_flex_grid_bulk",
+			{
+				{"panels", panels},
+				{"grids_per_panel", grids_per_panel},
+				{"grid_size", grid_size},
+			},
+			PxRect::FromWH(1920, 1080),
+			[=] {
+				ElementTreeBuilder builder;
+				builder.Reserve(1 + panels * (1 + grids_per_panel * (1 + grid_size * grid_size)));
+				const auto root = builder.Add(
+					ElementBuilder{}
+						.Flex(Axis::Vertical)
+						.AlignItems(Align::Stretch)
+						.Gap(Px{4})
+				);
+				for (int p = 0; p < panels; ++p) {
+					const auto panel = builder.Add(
+						ElementBuilder{}
+							.Flex()
+							.FlexGrow(1)
+							.JustifyContent(Justify::SpaceBetween)
+							.PaddingPxLTRB(4, 4, 4, 4),
+						root
+					);
+					for (int g = 0; g < grids_per_panel; ++g) {
+						const auto grid = builder.Add(
+							ElementBuilder{}
+								.Grid(grid_size, grid_size)
+								.Gap(Px{2})
+								.FlexGrow(1),
+							panel
+						);
+						for (int i = 0; i < grid_size * grid_size; ++i) {
+							builder.Add(ElementBuilder{}.MinSize(Px{4}, Px{4}), grid);
+						}
+					}
+				}
+				return builder.Build();
+			},
+		};
+	}
+
+	// one grid with many auto-placed items of mixed spans
+	BenchScene AutoGridSpans(int items, int columns) {
+		return BenchScene{
+			"auto_grid_spans",
+			{{"items", items}, {"columns", columns}},
+			PxRect::FromWH(1920, 1080),
+			[=] {
+				auto root = ElementBuilder{}
+					.Grid(0, columns)
+					.Gap(Px{2})
+					.Build();
+				for (int i = 0; i < items; ++i) {
+					ElementBuilder builder;
+					builder.ColSpan(1 + i % 3).RowSpan(1 + (i % 7 == 0));
+					if (i % 50 == 0) {
+						builder.Col((i / 50) % columns);
+					}
+					root->AddChild(builder.Build());
+				}
+				return root;
+			},
+		};
+	}
+
+	// a bushy tree where every container has percent padding and gaps
+	BenchScene PercentPadding(int depth, int branching) {
+		return BenchScene{
+			"percent_padding",
+			{{"depth", depth}, {"branching", branching}},
+			PxRect::FromWH(1920, 1080),
+			[=] {
+				const std::function<std::shared_ptr<Element>(int)> build = [&](int level) {
+					auto element = ElementBuilder{}
+						.Flex(level % 2 ? Axis::Vertical : Axis::Horizontal)
+						.AlignItems(Align::Stretch)
+						.PaddingPercentLTRB(0.01f, 0.02f, 0.01f, 0.02f)
+						.Gap(Percent{0.01f})
+						.FlexGrow(1)
+						.MinSize(Px{2}, Px{2})
+						.Build();
+					if (level < depth) {
+						for (int i = 0; i < branching; ++i) {
+							element->AddChild(build(level + 1));
+						}
+					}
+					return element;
+				};
+				return build(0);
+			},
+		};
+	}
+}
+
+std::vector<BenchScene> MakeBenchScenes(int scale) {
+	return {
+		DeepChain(250 * scale),
+		WideFlexRow(5000 * scale),
+		ShrinkToolbar(2000 * scale),
+		WrappedChips(2000 * scale),
+		NestedMix(10 * scale, 8, 4),
+		NestedMixBulk(10 * scale, 8, 4),
+		AutoGridSpans(2500 * scale, 40),
+		PercentPadding(3 + (scale > 1), 8),
+	};
+}
@@ -2,12 +2,22 @@
 
 #include <klay/Geometry.hpp>
 #include <klay/Layout.hpp>
+#include <klay/Flex.hpp>
+#include <klay/Grid.hpp>
+#include <klay/LayoutTrace.hpp>
 
 #include <kind/Kind.hpp>
 
 #include <vector>
 #include <memory>
-#include <any>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <functional>
+#include <variant>
 
 #define KLAY_DEFINE_ITERATOR_WRAPPER(member) \
 		auto begin() noexcept { return member.begin(); } \
@@ -27,6 +37,7 @@
 namespace Klay {
 	// forward
 	struct Element;
+	class ThreadPool;
 
 	struct ItemOptions {
 		std::optional<Align> align_self;
@@ -41,11 +52,271 @@ namespace Klay {
 		int col_span = 1;
 	};
 
+	/// @brief Inline storage for a small trivially copyable payload,
+	/// such as a color, an index or a pointer to application data.
+	/// The type is not stored, so it must be read back as the type it was
+	/// written as. Reading it is a plain load, and it never allocates.
+	struct UserData {
+		static constexpr size_t capacity = 16;
+
+		template<typename T>
+		static constexpr bool fits = std::is_trivially_copyable_v<T>
+			&& sizeof(T) <= capacity
+			&& alignof(T) <= alignof(std::max_align_t);
+
+		template<typename T> requires fits<T>
+		void Set(const T& value) noexcept {
+			std::memcpy(storage, &value, sizeof(T));
+		}
+
+		// bit_cast, so that T need not be default constructible
+		template<typename T> requires fits<T>
+		T Get() const noexcept {
+			std::array<std::byte, sizeof(T)> bytes;
+			std::copy_n(storage, sizeof(T), bytes.begin());
+			return std::bit_cast<T>(bytes);
+		}
+
+	private:
+		alignas(std::max_align_t) std::byte storage[capacity] {};
+	};
+
+	/// @brief Layout mode of an element.
+	/// The flex mode is stored inline. The grid mode, whose scratch
+	/// buffers would more than double the size of every element, and
+	/// other modes are owned through a pointer. The built-in modes are
+	/// called directly, other modes virtually.
+	class ElementLayoutMode {
+	public:
+		enum class Kind : std::uint8_t {
+			None,
+			Flex,
+			Grid,
+			Custom,
+		};
+
+		ElementLayoutMode() noexcept = default;
+		ElementLayoutMode(std::nullptr_t) noexcept {}
+
+		ElementLayoutMode(FlexLayoutMode mode) noexcept
+			: kind{Kind::Flex}, mode{std::move(mode)}
+		{}
+
+		ElementLayoutMode(GridLayoutMode mode)
+			: ElementLayoutMode{std::make_unique<GridLayoutMode>(std::move(mode))}
+		{}
+
+		/// @brief Takes ownership of mode. A flex mode is moved inline.
+		template<typename T> requires std::derived_from<T, LayoutMode>
+		ElementLayoutMode(std::unique_ptr<T> mode) noexcept {
+			if (!mode) {
+				return;
+			}
+			if constexpr (std::is_same_v<T, FlexLayoutMode>) {
+				*this = ElementLayoutMode{std::move(*mode)};
+			}
+			else if constexpr (std::is_same_v<T, GridLayoutMode>) {
+				kind = Kind::Grid;
+				this->mode = std::move(mode);
+			}
+			else {
+				kind = Kind::Custom;
+				this->mode = std::unique_ptr<LayoutMode>{std::move(mode)};
+			}
+		}
+
+		// the kind is kept apart from the variant index, which sits after
+		// the inline mode, so that leaves check it without touching it
+		constexpr Kind GetKind() const noexcept {
+			return kind;
+		}
+
+		explicit operator bool() const noexcept {
+			return kind != Kind::None;
+		}
+
+		LayoutMode* get() const noexcept {
+			switch (kind) {
+				case Kind::Flex:
+					return const_cast<FlexLayoutMode*>(std::get_if<FlexLayoutMode>(&mode));
+				case Kind::Grid:
+					return std::get_if<std::unique_ptr<GridLayoutMode>>(&mode)->get();
+				case Kind::Custom:
+					return std::get_if<std::unique_ptr<LayoutMode>>(&mode)->get();
+				default:
+					return nullptr;
+			}
+		}
+
+		LayoutMode& operator*() const noexcept {
+			return *get();
+		}
+
+		LayoutMode* operator->() const noexcept {
+			return get();
+		}
+
+		/// @brief The mode as a T, or nullptr if it is not one
+		template<typename T>
+		T* GetIf() noexcept {
+			if constexpr (std::is_same_v<T, FlexLayoutMode>) {
+				return std::get_if<FlexLayoutMode>(&mode);
+			}
+			else if constexpr (std::is_same_v<T, GridLayoutMode>) {
+				auto grid = std::get_if<std::unique_ptr<GridLayoutMode>>(&mode);
+				return grid ? grid->get() : nullptr;
+			}
+			else {
+				return dynamic_cast<T*>(get());
+			}
+		}
+
+		template<typename T>
+		const T* GetIf() const noexcept {
+			return const_cast<ElementLayoutMode*>(this)->GetIf<T>();
+		}
+
+		/// @brief Lays out the children of el, does nothing without a mode
+		void ComputeLayout(Element& el, const PxRect& content_rect) noexcept {
+			// qualified calls, so the built-in modes are not called virtually
+			switch (kind) {
+				case Kind::Flex:
+					std::get_if<FlexLayoutMode>(&mode)->FlexLayoutMode::ComputeLayout(el, content_rect);
+					break;
+				case Kind::Grid:
+					(*std::get_if<std::unique_ptr<GridLayoutMode>>(&mode))->GridLayoutMode::ComputeLayout(el, content_rect);
+					break;
+				case Kind::Custom:
+					(*std::get_if<std::unique_ptr<LayoutMode>>(&mode))->ComputeLayout(el, content_rect);
+					break;
+				default:
+					break;
+			}
+		}
+
+	private:
+		Kind kind = Kind::None;
+		std::variant<
+			std::monostate,
+			FlexLayoutMode,
+			std::unique_ptr<GridLayoutMode>,
+			std::unique_ptr<LayoutMode>
+		> mode;
+	};
+
+	/// @brief Elements whose rect changed during a layout pass
+	struct DamageList {
+		struct Change {
+			Element* element;
+			// nullopt if the element was never laid out before
+			std::optional<PxRect> old_rect;
+			PxRect new_rect;
+		};
+
+		std::vector<Change> changes;
+		// union of the old and new rects of every change
+		std::optional<PxRect> damage_rect;
+
+		bool Empty() const noexcept {
+			return changes.empty();
+		}
+
+		/// @brief Removes every change, keeping the capacity
+		void Clear() noexcept {
+			changes.clear();
+			damage_rect.reset();
+		}
+
+		void Add(Element& element, const std::optional<PxRect>& old_rect, const PxRect& new_rect) {
+			changes.push_back(Change{&element, old_rect, new_rect});
+			auto damage = old_rect ? old_rect->Union(new_rect) : new_rect;
+			damage_rect = damage_rect ? damage_rect->Union(damage) : damage;
+		}
+	};
+
+	/// @brief The inputs of the last layout of an element.
+	/// Percent gaps resolve against the content box within rect. Percent
+	/// sizes and padding resolve against the parent and are cached
+	/// separately, see Element::layout_size_basis.
+	struct LayoutCache {
+		PxRect rect;
+		bool valid = false;
+
+		constexpr bool Matches(const PxRect& rect) const noexcept {
+			return valid && this->rect == rect;
+		}
+	};
+
+	enum class MeasureMode {
+		// no constraint, measure the natural size of the content
+		Undefined,
+		// the content must fit in the available width
+		AtMost,
+	};
+
+	/// @brief Measures the content of a leaf, such as shaped text.
+	/// Returns the size of the content box.
+	/// May be called concurrently for different elements when laying out
+	/// on a ThreadPool.
+	using MeasureFunction = std::function<PxSize(
+		const Element& element,
+		Px available_width,
+		MeasureMode mode
+	)>;
+
+	/// @brief The last few measurements of an element, keyed by constraint
+	struct MeasureCache {
+		struct Entry {
+			Px available_width;
+			MeasureMode mode;
+			PxSize size;
+		};
+
+		static constexpr size_t capacity = 4;
+
+		std::array<Entry, capacity> entries {};
+		size_t count = 0;
+		// entry replaced when full
+		size_t next = 0;
+
+		constexpr const PxSize* Find(Px available_width, MeasureMode mode) const noexcept {
+			for (size_t i = 0; i < count; ++i) {
+				if (entries[i].mode == mode && entries[i].available_width == available_width) {
+					return &entries[i].size;
+				}
+			}
+			return nullptr;
+		}
+
+		constexpr void Insert(Px available_width, MeasureMode mode, const PxSize& size) noexcept {
+			entries[next] = Entry{available_width, mode, size};
+			next = (next + 1) % capacity;
+			count = std::max(count, next == 0 ? capacity : next);
+		}
+
+		constexpr void Clear() noexcept {
+			count = 0;
+			next = 0;
+		}
+	};
+
 	struct Element : public std::enable_shared_from_this<Element> {
 		using IDType = size_t;
 
 		bool dirty_size = true;
 		bool dirty_layout = true;
+		// whether this element has a preferred or max size, and whether
+		// its min size or padding has a percentage, updated along with
+		// the min size
+		bool has_size_limits = false;
+		bool has_percent_min_size = false;
+		bool has_percent_padding = false;
+		// whether any child has a preferred or max size,
+		// updated when this element lays out its children
+		bool limited_children = false;
+		// whether the layout sizes below were resolved against
+		// layout_size_basis since the min size last changed
+		bool layout_sizes_valid = false;
 
 		OptionalSizeRange size;
 
@@ -54,15 +325,41 @@ namespace Klay {
 
 		std::optional<IDType> id;
 
+		// intrinsic min size, with percentages of size.min and of the
+		// padding left unresolved, so it only depends on the subtree
 		PxSize computed_min_size;
+		// Sizes the parent lays this element out with, resolved against
+		// the content box of the parent, layout_size_basis, which the
+		// percent padding of the element also resolves against.
+		// layout_min_size is computed_min_size, or for measured elements
+		// the size measured against the content width, raised to the
+		// percentages of size.min. Without a value the preferred size is
+		// unset, and without a max the max size is unbounded_size.
+		PxSize layout_min_size;
+		OptionalPxSize computed_preferred_size;
+		PxSize computed_max_size = unbounded_size;
+		PxSize layout_size_basis;
+		// number of elements in the subtree rooted at this element,
+		// updated along with the min size
+		size_t subtree_size = 1;
 		PxSize computed_size;
 		PxPoint computed_position;
+		// union of the rects in the subtree, updated by ComputeTreeLayout
+		PxRect subtree_bounds;
 
 		LayoutOptions layout_options;
-		std::unique_ptr<LayoutMode> layout_mode;
 		ItemOptions item_options;
 
-		std::any user_data;
+		UserData user_data;
+
+		/// @brief If set, measures the content of this element during the
+		/// min size and layout passes. Results are cached until the
+		/// element is marked dirty.
+		MeasureFunction measure;
+
+		// after the fields read for every child, since the flex mode is
+		// stored inline and would otherwise spread them apart
+		ElementLayoutMode layout_mode;
 
 		inline PxRect ComputedRect() const noexcept {
 			return PxRect::FromPointSize(computed_position, computed_size);
@@ -70,16 +367,121 @@ namespace Klay {
 
 		inline Element() : size{} {}
 
+		/// @brief Lays out the children of this element.
+		/// Always lays them out, so fields changed without MarkDirty are
+		/// picked up. The tree passes below skip clean elements instead.
 		void ComputeLayout(const PxRect& parent_rect) noexcept;
 
+		/// @brief Computes the min size and layout of the whole tree rooted
+		/// at this element. Subtrees that are clean and whose rect did not
+		/// change since the last pass are skipped.
+		/// @param rect the rect of this element
+		void ComputeTreeLayout(const PxRect& rect) noexcept;
+
+		/// @brief Computes the whole tree like ComputeTreeLayout, but lays
+		/// out child subtrees with at least min_parallel_size elements as
+		/// tasks on pool. Each element is still laid out by the same code
+		/// from the same inputs, so the result matches the serial pass.
+		///
+		/// Layout modes must not share state between elements.
+		void ComputeTreeLayout(
+			const PxRect& rect,
+			ThreadPool& pool,
+			size_t min_parallel_size = default_min_parallel_size
+		) noexcept;
+
+		static constexpr size_t default_min_parallel_size = 1024;
+
+		/// @brief Computes the whole tree like ComputeTreeLayout, and fills
+		/// damage with every element whose rect differs from the rect it
+		/// was last laid out with, including this element.
+		/// damage is cleared first, so it can be reused every frame
+		/// without allocating.
+		void ComputeTreeLayout(const PxRect& rect, DamageList& damage) noexcept;
+
+		/// @brief Finds the deepest element of the subtree containing point.
+		/// Later siblings are on top of earlier ones. Subtrees whose bounds
+		/// do not contain point are skipped, so the cost follows the depth
+		/// of the hit rather than the size of the tree.
+		/// Uses the rects of the last ComputeTreeLayout.
+		/// @return the element, or null if nothing contains point
+		std::shared_ptr<Element> QueryPoint(const PxPoint& point) noexcept;
+
+		/// @brief Appends every element of the subtree whose rect intersects
+		/// rect to hits, in depth first order.
+		/// Uses the rects of the last ComputeTreeLayout.
+		void QueryRect(
+			const PxRect& rect,
+			std::vector<std::shared_ptr<Element>>& hits
+		);
+
 		std::shared_ptr<Element> AddChild(std::shared_ptr<Element> child) {
+			if (IsLayoutTraceRecording()) {
+				Detail::TraceAddChild(*this, *child);
+			}
 			children.push_back(child);
 			child->Reparent(weak_from_this());
+			MarkDirty();
 			return child;
 		}
 
 		void ComputeMinSize() noexcept;
 
+		/// @brief Marks this element as needing a min size and layout
+		/// recompute, and propagates both to its ancestors.
+		/// Call this after modifying a field directly, or use the setters.
+		void MarkDirty() noexcept;
+
+		/// @brief Marks only the layout of this element and its ancestors
+		/// as dirty, keeping their min sizes.
+		/// Call this after changing inputs that only the layout mode reads,
+		/// such as the scroll offset of a VirtualListLayoutMode.
+		void MarkLayoutDirty() noexcept;
+
+		void SetSize(const OptionalSizeRange& size) noexcept {
+			this->size = size;
+			MarkDirty();
+		}
+
+		void SetMinSize(const OptionalSize& min) noexcept {
+			size.min = min;
+			MarkDirty();
+		}
+
+		void SetPreferredSize(const OptionalSize& value) noexcept {
+			size.value = value;
+			MarkDirty();
+		}
+
+		void SetMaxSize(const OptionalSize& max) noexcept {
+			size.max = max;
+			MarkDirty();
+		}
+
+		void SetLayoutOptions(const LayoutOptions& options) noexcept {
+			layout_options = options;
+			MarkDirty();
+		}
+
+		void SetItemOptions(const ItemOptions& options) noexcept {
+			item_options = options;
+			MarkDirty();
+		}
+
+		void SetLayoutMode(ElementLayoutMode mode) noexcept {
+			layout_mode = std::move(mode);
+			MarkDirty();
+		}
+
+		void SetMeasureFunction(MeasureFunction function) noexcept {
+			measure = std::move(function);
+			MarkDirty();
+		}
+
+		/// @brief Measures the content with the measure function,
+		/// reusing a cached result for the same constraint
+		PxSize Measure(Px available_width, MeasureMode mode) noexcept;
+
 		void Reparent(std::weak_ptr<Element> parent) noexcept {
 			this->parent = parent;
 		}
@@ -91,6 +493,61 @@ namespace Klay {
 		KLAY_DEFINE_ITERATOR_WRAPPER(children)
 
 	private:
+		LayoutCache layout_cache;
+		MeasureCache measure_cache;
+
+		// checks the layout cache of the subtree and counts the visit
+		bool IsLayoutCached(const PxRect& rect) noexcept;
+		void ComputeLayoutUncached(const PxRect& rect) noexcept;
+		void ComputeSubtreeLayout(const PxRect& rect, DamageList* damage = nullptr) noexcept;
+		// sets subtree_bounds from rect and the bounds of the children
+		void ComputeSubtreeBounds(const PxRect& rect) noexcept;
+		void ComputeSubtreeLayout(
+			const PxRect& rect,
+			ThreadPool& pool,
+			size_t min_parallel_size
+		) noexcept;
+		// min size with content of the given size, resolving percent
+		// padding against basis
+		PxSize MinSizeForContent(PxSize content, const PxSize& basis) const noexcept;
+		// sum of the min sizes of the children
+		PxSize ChildrenMinSize() const noexcept;
+		// resolves the layout sizes against the content box of the parent,
+		// unless they already are. They only depend on basis and on inputs
+		// that mark the min size dirty, so when only the viewport changes
+		// they are resolved again in the layout pass, without recomputing
+		// any min size.
+		void ResolveLayoutSizes(const PxSize& basis) noexcept {
+			if(layout_sizes_valid && layout_size_basis == basis) {
+				return;
+			}
+			layout_size_basis = basis;
+			layout_sizes_valid = true;
+			if(has_percent_padding) {
+				// the content box changes even if the rect does not.
+				// The parent is being laid out, so it is already dirty.
+				dirty_layout = true;
+			}
+
+			if(measure) {
+				layout_min_size = MeasureLayoutMinSize(basis);
+			}
+			else if(has_percent_padding) {
+				// the min size was computed without the percent padding
+				layout_min_size = MinSizeForContent(ChildrenMinSize(), basis);
+			}
+			else {
+				layout_min_size = computed_min_size;
+			}
+			if(has_size_limits || has_percent_min_size) {
+				ResolveSizeRange(basis);
+			}
+		}
+		// resolves size against basis, for elements that have
+		// percentages or size limits
+		void ResolveSizeRange(const PxSize& basis) noexcept;
+		// min size measured against the content box of the parent
+		PxSize MeasureLayoutMinSize(const PxSize& basis) noexcept;
 		void AssignDefaultLayoutMode() noexcept;
 	};
 }
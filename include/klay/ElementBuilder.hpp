@@ -8,20 +8,30 @@
 
 namespace Klay {
 	class ElementBuilder {
+		friend class ElementTreeBuilder;
+
 		Element element;
 
 	public:
 		inline ElementBuilder& Flex(Axis axis = Axis::Horizontal) {
-			element.layout_mode = std::make_unique<FlexLayoutMode>(axis);
+			element.layout_mode = FlexLayoutMode{axis};
+			return *this;
+		}
+
+		/// @brief Sets whether items wrap onto new lines, making this a flex
+		inline ElementBuilder& Wrap(FlexWrap wrap = FlexWrap::Wrap) {
+			GetFlexLayoutMode().wrap = wrap;
 			return *this;
 		}
 
 		inline ElementBuilder& Grid(int rows, int cols) {
-			element.layout_mode = std::make_unique<GridLayoutMode>();
+			element.layout_mode = GridLayoutMode{};
 			return NumRows(rows).NumColumns(cols);
 		}
 
-		inline ElementBuilder& LayoutMode(std::unique_ptr<LayoutMode> mode) {
+		/// @brief Sets a layout mode, custom modes are passed
+		/// as a std::unique_ptr
+		inline ElementBuilder& LayoutMode(ElementLayoutMode mode) {
 			element.layout_mode = std::move(mode);
 			return *this;
 		}
@@ -36,6 +46,18 @@ namespace Klay {
 			return *this;
 		}
 
+		/// @brief Sets the sizes of the explicit rows, making this a grid
+		inline ElementBuilder& RowTracks(GridTrackList tracks) {
+			GetGridLayoutMode().row_track_list = std::move(tracks);
+			return *this;
+		}
+
+		/// @brief Sets the sizes of the explicit columns, making this a grid
+		inline ElementBuilder& ColumnTracks(GridTrackList tracks) {
+			GetGridLayoutMode().col_track_list = std::move(tracks);
+			return *this;
+		}
+
 		constexpr ElementBuilder& Row(int start) {
 			element.item_options.row_start = start;
 			return *this;
@@ -120,6 +142,38 @@ namespace Klay {
 			return *this;
 		}
 
+		/// @brief Preferred width, which items are laid out from
+		/// before growing or shrinking
+		constexpr ElementBuilder& Width(Unit width) {
+			element.size.value.Horizontal() = width;
+			return *this;
+		}
+
+		constexpr ElementBuilder& Height(Unit height) {
+			element.size.value.Vertical() = height;
+			return *this;
+		}
+
+		constexpr ElementBuilder& PreferredSize(Unit w, Unit h) {
+			element.size.value = {w, h};
+			return *this;
+		}
+
+		constexpr ElementBuilder& MaxWidth(Unit max) {
+			element.size.max.Horizontal() = max;
+			return *this;
+		}
+
+		constexpr ElementBuilder& MaxHeight(Unit max) {
+			element.size.max.Vertical() = max;
+			return *this;
+		}
+
+		constexpr ElementBuilder& MaxSize(Unit w, Unit h) {
+			element.size.max = {w, h};
+			return *this;
+		}
+
 		constexpr ElementBuilder& FlexGrow(float grow) {
 			element.item_options.grow = grow;
 			return *this;
@@ -171,13 +225,31 @@ namespace Klay {
 			return *this;
 		}
 
-		constexpr ElementBuilder& UserData(auto data) {
-			element.user_data = std::move(data);
+		template<typename T> requires Klay::UserData::fits<T>
+		ElementBuilder& UserData(const T& data) {
+			element.user_data.Set(data);
 			return *this;
 		}
 
 		std::shared_ptr<Element> Build() {
 			return std::make_shared<Element>(std::move(element));
 		}
+
+	private:
+		FlexLayoutMode& GetFlexLayoutMode() {
+			if (auto flex = element.layout_mode.GetIf<FlexLayoutMode>()) {
+				return *flex;
+			}
+			element.layout_mode = FlexLayoutMode{};
+			return *element.layout_mode.GetIf<FlexLayoutMode>();
+		}
+
+		GridLayoutMode& GetGridLayoutMode() {
+			if (auto grid = element.layout_mode.GetIf<GridLayoutMode>()) {
+				return *grid;
+			}
+			element.layout_mode = GridLayoutMode{};
+			return *element.layout_mode.GetIf<GridLayoutMode>();
+		}
 	};
 }
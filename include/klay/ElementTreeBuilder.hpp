@@ -0,0 +1,60 @@
+#pragma once
+
+#include <klay/Element.hpp>
+#include <klay/ElementBuilder.hpp>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace Klay {
+	struct ElementArena;
+
+	/// @brief Builds a whole subtree at once.
+	///
+	/// Elements are added by handle, with each parent added before its
+	/// children. They are created in place in a block sized by Reserve,
+	/// and Build reserves each child array with its exact size and links
+	/// parents and children in a single pass.
+	///
+	/// Child arrays are still allocated one by one, since Element::children
+	/// uses the default allocator so that it can be swapped with other
+	/// arrays, like VirtualList does. Each is allocated once, at its size.
+	///
+	/// A block is freed once every element in it is destroyed,
+	/// so elements can still be moved to other trees afterwards.
+	class ElementTreeBuilder {
+	public:
+		static constexpr size_t null_handle = std::numeric_limits<size_t>::max();
+
+		/// @brief Reserves room for count elements in total.
+		/// Elements past the reserved count go to further blocks.
+		void Reserve(size_t count);
+
+		constexpr size_t Size() const noexcept {
+			return elements.size();
+		}
+
+		/// @brief Moves the element of builder in as the last child of parent
+		/// @param parent the handle of an element already added, or
+		/// null_handle for the root. Only the first element may be a root.
+		/// @return the handle of the new element
+		size_t Add(ElementBuilder& builder, size_t parent = null_handle);
+
+		size_t Add(ElementBuilder&& builder, size_t parent = null_handle) {
+			return Add(builder, parent);
+		}
+
+		/// @brief Creates the elements added so far and resets the builder
+		/// @return the root, or nullptr if nothing was added
+		std::shared_ptr<Element> Build();
+
+	private:
+		std::shared_ptr<ElementArena> arena;
+		size_t reserved = 0;
+
+		std::vector<std::shared_ptr<Element>> elements;
+		std::vector<size_t> parents;
+		std::vector<size_t> num_children;
+	};
+}
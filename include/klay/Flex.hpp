@@ -2,18 +2,441 @@
 
 #include <klay/Layout.hpp>
 #include <klay/Geometry.hpp>
+#include <klay/FlexKernel.hpp>
+#include <klay/Stats.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 namespace Klay {
+	enum class FlexWrap {
+		// all items on one line
+		NoWrap,
+		// items that overflow the main axis start a new line
+		Wrap,
+	};
+
+	/// @brief A line of a wrapped flex container
+	struct FlexLine {
+		// index of the first item of the line
+		size_t start = 0;
+		size_t count = 0;
+		// relative to the cross start of the content box
+		Px cross_offset;
+		// largest preferred size of the items along the cross axis
+		Px cross_size;
+
+		constexpr size_t End() const noexcept {
+			return start + count;
+		}
+	};
+
+	/// @brief Applies justify-content to a line with remaining_space
+	/// left over after its items are sized
+	constexpr void JustifyFlexLine(
+		FlexLineParams& params,
+		Justify justify_content,
+		float remaining_space,
+		size_t num_items
+	) noexcept {
+		switch(justify_content) {
+			case Justify::Start:
+				break;
+			case Justify::End:
+				params.main_offset = remaining_space;
+				break;
+			case Justify::Center:
+				params.main_offset = remaining_space / 2;
+				break;
+			case Justify::SpaceAround: {
+				// split remaining space between the leftOffset, gap, and rightOffset
+				const float split = remaining_space / num_items;
+				params.main_offset = split / 2;
+				params.gap += split;
+				break;
+			}
+			case Justify::SpaceEvenly: {
+				const float split = remaining_space / (num_items + 1);
+				params.main_offset = split;
+				params.gap += split;
+				break;
+			}
+			case Justify::SpaceBetween:
+				params.gap += remaining_space / (num_items - 1);
+				break;
+		}
+	}
+
+	/// @brief Resolves the extra space, gap and justify-content offset
+	/// of a flex line from the sums over its items.
+	/// Items grow into positive free space and shrink out of negative
+	/// free space. Max sizes and shrinking below min sizes are left for
+	/// ComputeFlexLine, see FreezeFlexItems.
+	constexpr FlexLineParams ResolveFlexLineParams(
+		Axis main_axis,
+		const LayoutOptions& layout_options,
+		const PxRect& contentRect,
+		size_t num_items,
+		const FlexLineSums& sums
+	) noexcept {
+		const Axis cross_axis = CrossAxis(main_axis);
+		FlexLineParams params;
+		params.total_grow = sums.grow;
+		params.gap = ResolveGaps(layout_options, contentRect, main_axis).main.value;
+		const float free_space = contentRect.GetAxis(main_axis).length.value
+			- sums.min_main
+			- params.gap * (num_items - 1);
+		params.main_start = contentRect.GetAxis(main_axis).start.value;
+		params.cross_start = contentRect.GetAxis(cross_axis).start.value;
+		params.cross_length = contentRect.GetAxis(cross_axis).length.value;
+
+		if(free_space < 0) {
+			if(sums.shrink > 0) {
+				params.shrink_space = -free_space;
+				return params;
+			}
+		}
+		else {
+			params.extra_space = free_space;
+		}
+
+		// justify content doesn't make sense if there is no extra space,
+		// and without grow the extra space is all left over
+		if(sums.grow == 0 || free_space < 0){
+			JustifyFlexLine(params, layout_options.justify_content, free_space, num_items);
+		}
+		return params;
+	}
+
+	/// @brief Item of a line that grows up to max sizes or shrinks down
+	/// to min sizes, see FreezeFlexItems
+	struct FlexFreezeItem {
+		// ratio of space to weight at which the item reaches its limit
+		float threshold;
+		// grow factor, or shrink factor scaled by the base size
+		float weight;
+		// how far the item can grow or shrink
+		float room;
+	};
+
+	struct FlexFreezeResult {
+		// space and weight left to the items that are not frozen
+		float space;
+		float weight;
+		size_t num_frozen;
+	};
+
+	/// @brief Scratch items of the calling thread
+	std::vector<FlexFreezeItem>& GetFlexFreezeScratch() noexcept;
+
+	/// @brief Freezes the items that reach their limit when space is
+	/// split between items in proportion to their weight.
+	///
+	/// The space of a frozen item is split between the others, which
+	/// only raises the ratio of space to weight. So items freeze in
+	/// threshold order, and a single sweep after sorting finds all of
+	/// them in O(n log n), instead of distributing the space again
+	/// after every freeze.
+	/// @param weight total weight, including items without a limit,
+	/// which are left out of items
+	constexpr FlexFreezeResult FreezeFlexItems(
+		std::vector<FlexFreezeItem>& items,
+		float space,
+		float weight
+	) noexcept {
+		std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+			return a.threshold < b.threshold;
+		});
+
+		FlexFreezeResult result {space, weight, 0};
+		for(const auto& item : items) {
+			if(item.threshold > result.space / result.weight) {
+				break;
+			}
+			result.space -= item.room;
+			result.weight -= item.weight;
+			++result.num_frozen;
+			if(result.weight <= 0) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	/// @brief Main axis length of an item on a shrinking line.
+	/// An item shrinks in proportion to its shrink factor times its
+	/// base size, and never below its min size.
+	constexpr float FlexShrunkLength(
+		float base_length,
+		float min_length,
+		float shrink,
+		const FlexLineParams& params
+	) noexcept {
+		if(shrink <= 0) {
+			return base_length;
+		}
+		return std::max(min_length, base_length - params.shrink_ratio * (shrink * base_length));
+	}
+
+	/// @brief Freezes the items of a line that reach their min size when
+	/// shrinking or their max size when growing, see FreezeFlexItems
+	/// @return params with the space and weight left to the other items
+	template<typename Items>
+	constexpr FlexLineParams FreezeFlexLine(
+		FlexLineParams params,
+		Axis main_axis,
+		const LayoutOptions& layout_options,
+		const Items& items,
+		const FlexLineSums& sums,
+		std::vector<FlexFreezeItem>& scratch
+	) noexcept {
+		const auto num_items = items.Size();
+		scratch.clear();
+		if(params.shrink_space > 0) {
+			for(size_t i = 0; i < num_items; ++i) {
+				const float base_main = items.PreferredSize(i).GetAxis(main_axis).value;
+				const float weight = items.Shrink(i) * base_main;
+				if(weight > 0) {
+					const float room = base_main - items.MinSize(i).GetAxis(main_axis).value;
+					scratch.push_back(FlexFreezeItem{room / weight, weight, room});
+				}
+			}
+			const auto result = FreezeFlexItems(scratch, params.shrink_space, sums.shrink);
+			params.shrink_ratio = result.num_frozen == scratch.size() || result.weight <= 0
+				? std::numeric_limits<float>::infinity()
+				: result.space / result.weight;
+			return params;
+		}
+
+		size_t num_growing = 0;
+		for(size_t i = 0; i < num_items; ++i) {
+			const float grow = items.Grow(i);
+			if(grow <= 0) {
+				continue;
+			}
+			++num_growing;
+			const float max_main = items.MaxSize(i).GetAxis(main_axis).value;
+			if(max_main < std::numeric_limits<float>::infinity()) {
+				const float room = max_main - items.PreferredSize(i).GetAxis(main_axis).value;
+				scratch.push_back(FlexFreezeItem{room / grow, grow, room});
+			}
+		}
+		if(scratch.empty()) {
+			return params;
+		}
+		const auto result = FreezeFlexItems(scratch, params.extra_space, params.total_grow);
+		if(result.num_frozen < num_growing && result.weight > 0) {
+			params.extra_space = result.space;
+			params.total_grow = result.weight;
+		}
+		else {
+			// every item is at its max size, the rest is left over
+			params.extra_space = std::numeric_limits<float>::infinity();
+			JustifyFlexLine(params, layout_options.justify_content, result.space, num_items);
+		}
+		return params;
+	}
+
+	/// @brief Lays out items on a single flex line filling contentRect.
+	/// Items is an accessor with Size, MinSize, PreferredSize, MaxSize,
+	/// Grow, Shrink, AlignSelf, ComputedSize and ComputedPosition, indexed
+	/// from 0, so the same algorithm runs over Element children,
+	/// LayoutTree nodes and static layouts.
+	///
+	/// Items start at their preferred size, which is clamped between
+	/// their min and max sizes. They grow up to their max size, the
+	/// space they cannot take going to the others, and shrink down to
+	/// their min size. Stretched items stop at their max cross size.
+	///
+	/// Lines without max sizes that do not shrink match the kernels of
+	/// FlexKernel.hpp, which use the same sums and per item steps, bit
+	/// for bit. Elements and LayoutTree run the kernels for such lines
+	/// once they are wide enough, see flex_kernel_min_items.
+	template<typename Items>
+	constexpr void ComputeFlexLine(
+		Axis main_axis,
+		const LayoutOptions& layout_options,
+		const PxRect& contentRect,
+		const Items& items
+	) noexcept {
+		const auto num_items = items.Size();
+		const Axis cross_axis = CrossAxis(main_axis);
+
+		// calculate total flex grow and shrink
+		// and base size along the main axis
+		float base_main_lanes[flex_kernel_lanes] {};
+		float grow_lanes[flex_kernel_lanes] {};
+		float shrink_lanes[flex_kernel_lanes] {};
+		// without max sizes on the main axis growing items never freeze
+		bool bounded_main = false;
+		for(size_t i = 0; i < num_items; ++i) {
+			const float base_main = items.PreferredSize(i).GetAxis(main_axis).value;
+			base_main_lanes[i % flex_kernel_lanes] += base_main;
+			grow_lanes[i % flex_kernel_lanes] += items.Grow(i);
+			shrink_lanes[i % flex_kernel_lanes] += std::max(0.0f, items.Shrink(i)) * base_main;
+			bounded_main |= items.MaxSize(i).GetAxis(main_axis).value < std::numeric_limits<float>::infinity();
+		}
+		const FlexLineSums sums {
+			FoldFlexLanes(base_main_lanes),
+			FoldFlexLanes(grow_lanes),
+			FoldFlexLanes(shrink_lanes),
+		};
+		// the params are only written here, so they stay in registers
+		// in the loop below
+		const auto params = [&] {
+			const auto resolved = ResolveFlexLineParams(
+				main_axis,
+				layout_options,
+				contentRect,
+				num_items,
+				sums
+			);
+			const bool grows = resolved.extra_space > 0 && resolved.total_grow > 0;
+			if(resolved.shrink_space <= 0 && !(bounded_main && grows)) {
+				return resolved;
+			}
+			if(std::is_constant_evaluated()) {
+				std::vector<FlexFreezeItem> scratch;
+				return FreezeFlexLine(resolved, main_axis, layout_options, items, sums, scratch);
+			}
+			auto& scratch = GetFlexFreezeScratch();
+			const auto capacity = scratch.capacity();
+			const auto frozen = FreezeFlexLine(resolved, main_axis, layout_options, items, sums, scratch);
+			CountLayoutStat(LayoutCounter::ScratchGrowths, scratch.capacity() != capacity);
+			return frozen;
+		}();
+
+		// apply flex grow or shrink and, if align items or align self is
+		// stretch, stretch item across cross axis, then position the item
+		float main_axis_offset = params.main_offset;
+		for(size_t i = 0; i < num_items; ++i) {
+			auto& computed_size = items.ComputedSize(i);
+			auto& computed_position = items.ComputedPosition(i);
+			const auto base_size = items.PreferredSize(i);
+			const auto max_size = items.MaxSize(i);
+			const auto align = items.AlignSelf(i).value_or(layout_options.align_items);
+
+			const float main_length = params.shrink_space > 0
+				? FlexShrunkLength(
+					base_size.GetAxis(main_axis).value,
+					items.MinSize(i).GetAxis(main_axis).value,
+					items.Shrink(i),
+					params
+				)
+				: std::min(
+					max_size.GetAxis(main_axis).value,
+					FlexGrownLength(base_size.GetAxis(main_axis).value, items.Grow(i), params)
+				);
+			const float cross_length = std::min(
+				max_size.GetAxis(cross_axis).value,
+				FlexCrossLength(base_size.GetAxis(cross_axis).value, align, params)
+			);
+			computed_size.GetAxis(main_axis) = main_length;
+			computed_size.GetAxis(cross_axis) = cross_length;
+
+			computed_position.GetAxis(main_axis) = params.main_start + main_axis_offset;
+			main_axis_offset += main_length + params.gap;
+			computed_position.GetAxis(cross_axis) = FlexCrossPosition(cross_length, align, params);
+		}
+	}
+
 	struct FlexLayoutMode : LayoutMode {
 		Axis main_axis;
+		FlexWrap wrap;
 
-		constexpr FlexLayoutMode(Axis mainAxis = Axis::Horizontal) noexcept
-			: main_axis{mainAxis}
+		constexpr FlexLayoutMode(
+			Axis mainAxis = Axis::Horizontal,
+			FlexWrap wrap = FlexWrap::NoWrap
+		) noexcept
+			: main_axis{mainAxis}, wrap{wrap}
 		{}
 
+		// copies lay out their own items, so they start without cached lines
+		FlexLayoutMode(const FlexLayoutMode& other) noexcept
+			: main_axis{other.main_axis}, wrap{other.wrap}
+		{}
+
+		FlexLayoutMode(FlexLayoutMode&&) noexcept = default;
+
+		FlexLayoutMode& operator=(const FlexLayoutMode& other) noexcept {
+			main_axis = other.main_axis;
+			wrap = other.wrap;
+			line_cache.reset();
+			return *this;
+		}
+
+		FlexLayoutMode& operator=(FlexLayoutMode&&) noexcept = default;
+
 		void ComputeLayout(
-			std::shared_ptr<Element> el,
+			Element& el,
 			const PxRect& content_rect
 		) noexcept override;
+
+		/// @brief Lays out the children of node in a LayoutTree
+		void ComputeLayout(
+			LayoutTree& tree,
+			NodeHandle node,
+			const PxRect& content_rect
+		) noexcept;
+
+		/// @brief Lines of the last wrapped layout
+		std::span<const FlexLine> GetLines() const noexcept {
+			if (!line_cache) {
+				return {};
+			}
+			return line_cache->lines;
+		}
+
+		/// @brief Forgets the cached lines, so the next wrapped layout
+		/// breaks every line again.
+		/// Lines are reused up to the first child that is dirty or was not
+		/// at its index in the last layout, so call this after changing the
+		/// fields of a child without marking it dirty.
+		void InvalidateLines() noexcept {
+			if (line_cache) {
+				line_cache->valid = false;
+			}
+		}
+
+	private:
+		// inputs of the cached lines
+		struct LineCacheKey {
+			PxRect content_rect;
+			Px main_gap;
+			Px cross_gap;
+			Justify justify_content;
+			Align align_items;
+
+			constexpr bool operator==(const LineCacheKey&) const noexcept = default;
+		};
+
+		struct LineCache {
+			std::vector<FlexLine> lines;
+			LineCacheKey key {};
+			size_t num_items = 0;
+			bool valid = false;
+			// children of the element the lines were broken for,
+			// so that removed or moved children are not reused
+			std::vector<const Element*> children;
+		};
+
+		// allocated by the first wrapped layout, so that containers
+		// that do not wrap stay small
+		std::unique_ptr<LineCache> line_cache;
+
+		/// @brief Breaks items into lines, starting from the line containing
+		/// first_dirty, and lays out each of those lines
+		template<typename Items>
+		void ComputeWrappedLayout(
+			const LayoutOptions& layout_options,
+			const PxRect& content_rect,
+			const Items& items,
+			size_t first_dirty
+		) noexcept;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <klay/Layout.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Klay {
+	/// @brief Resolved inputs of a single flex line, shared by the scalar
+	/// layout and the vectorized kernels
+	struct FlexLineParams {
+		// free space given to growing items, never negative, and infinite
+		// once every growing item is at its max size, see FreezeFlexLine
+		float extra_space = 0;
+		float total_grow = 0;
+		// space the items overflow the line by, taken from shrinking items
+		float shrink_space = 0;
+		// shrink of an item per unit of its scaled shrink factor,
+		// see FreezeFlexLine
+		float shrink_ratio = 0;
+		// start of the content box along the main axis
+		float main_start = 0;
+		// offset of the first item from justify-content
+		float main_offset = 0;
+		float gap = 0;
+		float cross_start = 0;
+		float cross_length = 0;
+	};
+
+	/// @brief Width of the sums over a line. Sums are accumulated in this
+	/// many lanes and then folded in a fixed order, so every instruction
+	/// set, and the scalar layout, adds the same numbers in the same order.
+	constexpr size_t flex_kernel_lanes = 8;
+
+	constexpr float FoldFlexLanes(const float (&lanes)[flex_kernel_lanes]) noexcept {
+		float half[4] {};
+		for (int i = 0; i < 4; ++i) {
+			half[i] = lanes[i] + lanes[i + 4];
+		}
+		return (half[0] + half[2]) + (half[1] + half[3]);
+	}
+
+	// The per item steps of a flex line. The kernels compute the same
+	// operations in the same order, so results are bit-exact.
+
+	constexpr float FlexGrownLength(float min_length, float grow, const FlexLineParams& params) noexcept {
+		return grow > 0
+			? min_length + params.extra_space * grow / params.total_grow
+			: min_length;
+	}
+
+	constexpr float FlexCrossLength(float min_length, Align align, const FlexLineParams& params) noexcept {
+		return align == Align::Stretch ? params.cross_length : min_length;
+	}
+
+	constexpr float FlexCrossPosition(float length, Align align, const FlexLineParams& params) noexcept {
+		const float extra = params.cross_length - length;
+		const float offset = align == Align::End
+			? extra
+			: align == Align::Center ? extra * 0.5f : 0.0f;
+		return params.cross_start + offset;
+	}
+
+	/// @brief Instruction sets of the flex kernels
+	enum class FlexKernelIsa {
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON,
+	};
+
+	/// @brief The instruction set the flex kernels run with,
+	/// the widest one the CPU supports unless set otherwise
+	FlexKernelIsa GetFlexKernelIsa() noexcept;
+
+	/// @brief Runs the flex kernels with isa, for tests and benchmarks
+	/// @return false, leaving the current one, if isa is not supported
+	bool SetFlexKernelIsa(FlexKernelIsa isa) noexcept;
+
+	bool IsFlexKernelIsaSupported(FlexKernelIsa isa) noexcept;
+
+	/// @brief Lines of elements and LayoutTree nodes with at least this
+	/// many children run the kernels, if the line does not wrap and its items have no
+	/// preferred or max sizes and do not shrink. Shorter lines are not
+	/// worth gathering into a FlexLineScratch.
+	constexpr size_t flex_kernel_min_items = 32;
+
+	/// @brief Items of a flex line in structure of arrays form.
+	/// The kernels below lay out lines kept in this form, giving the
+	/// same results as ComputeFlexLine, see ResolveFlexLineParams.
+	struct FlexLineScratch {
+		// inputs
+		std::vector<float> min_main;
+		std::vector<float> min_cross;
+		std::vector<float> grow;
+		// Align of each item, with align-self resolved
+		std::vector<std::uint32_t> align;
+
+		// outputs
+		std::vector<float> main_size;
+		std::vector<float> cross_size;
+		std::vector<float> main_position;
+		std::vector<float> cross_position;
+
+		/// @return whether any array had to grow its capacity
+		bool Resize(size_t count);
+	};
+
+	/// @brief Scratch arrays of the calling thread
+	FlexLineScratch& GetFlexLineScratch() noexcept;
+
+	struct FlexLineSums {
+		float min_main = 0;
+		float grow = 0;
+		// sum of the shrink factors scaled by the min sizes
+		float shrink = 0;
+	};
+
+	/// @brief Sums the main axis min sizes and grow factors of count items.
+	/// Lines in this form do not shrink, so the shrink sum is left at 0.
+	FlexLineSums SumFlexLine(const FlexLineScratch& scratch, size_t count) noexcept;
+
+	/// @brief Computes the sizes and positions of count items,
+	/// with params resolved from the sums of SumFlexLine
+	void ComputeFlexLineItems(
+		FlexLineScratch& scratch,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept;
+}
@@ -2,6 +2,7 @@
 
 #include <variant>
 #include <optional>
+#include <algorithm>
 
 #include <klay/Unit.hpp>
 
@@ -204,11 +205,44 @@ namespace Klay {
 		constexpr T Height() const {
 			return this->GetAxis(Axis::Vertical).length;
 		}
+
+		/// @brief Whether point is inside, including the left and top
+		/// edges but not the right and bottom edges
+		constexpr bool Contains(const Vector2<T>& point) const {
+			for (int i = 0; i < 2; ++i) {
+				if (point.axes[i] < this->axes[i].start || !(point.axes[i] < this->axes[i].End())) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// @brief Whether the rects overlap, touching edges do not count
+		constexpr bool Intersects(const Rect& other) const {
+			for (int i = 0; i < 2; ++i) {
+				if (!(this->axes[i].start < other.axes[i].End())
+					|| !(other.axes[i].start < this->axes[i].End())) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// @brief Smallest rect containing both rects
+		constexpr Rect Union(const Rect& other) const {
+			return FromLTRB(
+				std::min(X(), other.X()),
+				std::min(Y(), other.Y()),
+				std::max(this->axes[0].End(), other.axes[0].End()),
+				std::max(this->axes[1].End(), other.axes[1].End())
+			);
+		}
 	};
 
 	using PxSize = Vector2<Px>;
 	using Size = Vector2<Unit>;
 	using OptionalSize = Vector2<std::optional<Unit>>;
+	using OptionalPxSize = Vector2<std::optional<Px>>;
 
 	using PxRange = Range<Px>;
 	using UnitRange = Range<Unit>;
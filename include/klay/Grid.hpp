@@ -3,7 +3,14 @@
 #include <klay/Layout.hpp>
 #include <klay/Geometry.hpp>
 #include <klay/Unit.hpp>
+#include <klay/Stats.hpp>
 #include <vector>
+#include <array>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
 
 namespace Klay {
 	KLAY_DEFINE_UNIT(GridFr, float);
@@ -94,6 +101,190 @@ namespace Klay {
 		}
 	};
 
+	/// @brief Grid of occupied cells with one bit per cell.
+	/// Each row is a run of 64 bit words, so testing or marking a span of
+	/// up to 64 columns in a row takes one or two word operations.
+	/// Cells outside the grid are free.
+	struct OccupancyGrid {
+		using Word = std::uint64_t;
+		constexpr static int word_bits = 64;
+		constexpr static int no_column = -1;
+
+		int num_rows = 0;
+		int num_cols = 0;
+		int cap_rows = 0;
+		int words_per_row = 0;
+		std::vector<Word> data;
+
+		constexpr OccupancyGrid(int rows = 0, int cols = 0) {
+			resize(rows, cols);
+		}
+
+		/// @brief Frees every cell and sets the size, keeping the capacity
+		constexpr auto reset(int rows, int cols) -> void {
+			std::fill(data.begin(), data.end(), Word{0});
+			num_rows = 0;
+			num_cols = 0;
+			resize(rows, cols);
+		}
+
+		constexpr auto ensure_size(int rows, int cols) -> bool {
+			if (rows > num_rows || cols > num_cols) {
+				resize(std::max(rows, num_rows), std::max(cols, num_cols));
+				return true;
+			}
+			return false;
+		}
+
+		constexpr auto resize(int new_rows, int new_cols) -> void {
+			const int new_words_per_row = std::max(
+				words_per_row,
+				(new_cols + word_bits - 1) / word_bits
+			);
+			const int new_cap_rows = new_rows > cap_rows
+				? std::max(2 * new_rows, 1)
+				: cap_rows;
+
+			if (new_words_per_row != words_per_row || new_cap_rows != cap_rows) {
+				std::vector<Word> new_data(
+					static_cast<size_t>(new_cap_rows) * new_words_per_row
+				);
+				for (int row = 0; row < num_rows; ++row) {
+					for (int word = 0; word < words_per_row; ++word) {
+						new_data[row * new_words_per_row + word] =
+							data[row * words_per_row + word];
+					}
+				}
+				data = std::move(new_data);
+				words_per_row = new_words_per_row;
+				cap_rows = new_cap_rows;
+			}
+			num_rows = new_rows;
+			num_cols = new_cols;
+		}
+
+		constexpr auto get_cell(int row, int col) const -> bool {
+			return occupied_word(row, row + 1, col / word_bits)
+				& (Word{1} << (col % word_bits));
+		}
+
+		/// @brief Checks if every cell in the area is free
+		constexpr auto is_free(
+			int row_start, int row_span,
+			int col_start, int col_span
+		) const -> bool {
+			const int row_end = std::min(row_start + row_span, num_rows);
+			const int col_end = std::min(col_start + col_span, num_cols);
+			if (col_start >= col_end) {
+				return true;
+			}
+			for (int row = row_start; row < row_end; ++row) {
+				const Word* row_data = &data[row * words_per_row];
+				const int first_word = col_start / word_bits;
+				const int last_word = (col_end - 1) / word_bits;
+				for (int word = first_word; word <= last_word; ++word) {
+					if (row_data[word] & span_mask(word, col_start, col_end)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		/// @brief Marks every cell in the area as occupied,
+		/// growing the grid if necessary
+		constexpr auto mark(
+			int row_start, int row_span,
+			int col_start, int col_span
+		) -> void {
+			const int col_end = col_start + col_span;
+			ensure_size(row_start + row_span, col_end);
+			if (col_span <= 0) {
+				return;
+			}
+			const int first_word = col_start / word_bits;
+			const int last_word = (col_end - 1) / word_bits;
+			for (int row = row_start; row < row_start + row_span; ++row) {
+				Word* row_data = &data[row * words_per_row];
+				for (int word = first_word; word <= last_word; ++word) {
+					row_data[word] |= span_mask(word, col_start, col_end);
+				}
+			}
+		}
+
+		/// @brief Finds the first column at or after col_start where the area
+		/// is free, and which ends at or before col_limit
+		/// @return the column, or no_column
+		constexpr auto find_free(
+			int row_start, int row_span,
+			int col_start, int col_span,
+			int col_limit = std::numeric_limits<int>::max()
+		) const -> int {
+			int col = col_start;
+			while (col <= col_limit - col_span) {
+				// skip to the first free column
+				col = find_bit(row_start, row_start + row_span, col, false);
+				if (col > col_limit - col_span) {
+					break;
+				}
+				// and check that the free run is long enough
+				const int occupied = find_bit(row_start, row_start + row_span, col, true);
+				if (occupied - col >= col_span) {
+					return col;
+				}
+				col = occupied;
+			}
+			return no_column;
+		}
+
+	private:
+		// mask of the columns [col_start, col_end) that lie in word
+		constexpr static auto span_mask(int word, int col_start, int col_end) -> Word {
+			const int word_start = word * word_bits;
+			const int lo = std::max(col_start - word_start, 0);
+			const int hi = std::min(col_end - word_start, word_bits);
+			const Word high_mask = hi == word_bits
+				? ~Word{0}
+				: (Word{1} << hi) - 1;
+			return high_mask & (~Word{0} << lo);
+		}
+
+		// union of the occupied cells of rows [row_start, row_end) in word
+		constexpr auto occupied_word(int row_start, int row_end, int word) const -> Word {
+			if (word >= words_per_row) {
+				return 0;
+			}
+			Word occupied = 0;
+			for (int row = row_start; row < std::min(row_end, num_rows); ++row) {
+				occupied |= data[row * words_per_row + word];
+			}
+			return occupied;
+		}
+
+		// first column at or after col that is occupied in any of the rows,
+		// or free in all of them
+		constexpr auto find_bit(int row_start, int row_end, int col, bool occupied) const -> int {
+			for (int word = col / word_bits; ; ++word) {
+				if (word >= words_per_row) {
+					// everything past the stored words is free
+					return occupied
+						? std::numeric_limits<int>::max()
+						: std::max(col, word * word_bits);
+				}
+				Word bits = occupied_word(row_start, row_end, word);
+				if (!occupied) {
+					bits = ~bits;
+				}
+				if (word == col / word_bits) {
+					bits &= ~Word{0} << (col % word_bits);
+				}
+				if (bits) {
+					return word * word_bits + std::countr_zero(bits);
+				}
+			}
+		}
+	};
+
 	using GridExplicitTrackSize = std::variant<GridFr, Px, Percent>;
 
 	struct GridRepeat {
@@ -124,29 +315,381 @@ namespace Klay {
 				}
 			}
 		}
+
+		constexpr GridTrackList(
+			std::initializer_list<std::variant<GridExplicitTrackSize, GridRepeat>> sizes
+		) : GridTrackList{
+			std::vector<std::variant<GridExplicitTrackSize, GridRepeat>>(sizes)
+		} {}
+	};
+
+	/// @brief Where a grid item asks to be placed.
+	/// A missing start means the item is auto-placed along that axis.
+	struct GridItemPlacement {
+		std::optional<int> row_start;
+		int row_span = 1;
+		std::optional<int> col_start;
+		int col_span = 1;
 	};
 
-	struct GridLayoutMode : LayoutMode {
+	/// @brief Rect of an item in its grid area, at the start of the area.
+	/// Items fill their area, or take their preferred size on the axes
+	/// they have one, clamped between their min and max sizes and never
+	/// past the area.
+	constexpr PxRect FitGridItem(
+		const PxRect& area,
+		const OptionalPxSize& preferred,
+		const PxSize& min,
+		const PxSize& max
+	) noexcept {
+		const auto size = PxSize{area.Width(), area.Height()}.Transform([&](Px length, Axis axis) {
+			const Px wanted = preferred.GetAxis(axis).value_or(length);
+			return std::min(length, std::max(min.GetAxis(axis), std::min(wanted, max.GetAxis(axis))));
+		});
+		return PxRect::FromPointSize(PxPoint{area.X(), area.Y()}, size);
+	}
+
+	/// @brief Item placement and track sizing of a grid.
+	/// Works on placements rather than elements, so it can run at
+	/// compile time.
+	/// Tracks are sized from the track lists, and tracks without a size,
+	/// including those of the implicit grid, are 1fr.
+	struct GridItemLayout {
 		std::optional<GridTrackList> row_track_list;
 		std::optional<GridTrackList> col_track_list;
 
+		constexpr auto GetExplicitGridSize() const noexcept -> Vector2<int> {
+			return explicit_grid_size;
+		}
+
+		constexpr auto GetImplicitGridSize() const noexcept -> Vector2<int> {
+			return implicit_grid_size;
+		}
+
+		/// @brief Places items and computes their rects
+		constexpr void ComputeItemRects(
+			const LayoutOptions& layout_options,
+			std::span<const GridItemPlacement> items,
+			const PxRect& content_rect
+		) noexcept;
+
+		/// @brief Rects of the items of the last ComputeItemRects call,
+		/// indexed like the items
+		constexpr auto GetItemRects() const noexcept -> std::span<const PxRect> {
+			return item_rects;
+		}
+
+	protected:
+		Vector2<int> explicit_grid_size {0, 0};
+		Vector2<int> implicit_grid_size {0, 0};
+
+		// scratch state, kept between layouts so that
+		// relayouts don't allocate once warmed up
+		OccupancyGrid occupancy;
+		std::vector<GridItemPlacement> item_placements;
+		// placement of each item in tracks, indexed like the items
+		std::vector<Vector2<Segment<int>>> item_areas;
+		// rect of each item, indexed like the items
+		std::vector<PxRect> item_rects;
+		// start of each track relative to the content box,
+		// with one extra entry for the end of the last track
+		std::vector<Px> col_offsets;
+		std::vector<Px> row_offsets;
+
+		// Resolves the size of each track into offsets, so that offsets[i] is the
+		// start of track i and offsets[i + 1] - offsets[i] is its size plus the
+		// gap after it. An area spanning tracks [start, end) is then
+		// offsets[end] - offsets[start] - gap long.
+		//
+		// Explicit tracks without a size in the track list, and implicit tracks,
+		// are 1fr.
+		// see https://www.w3.org/TR/css-grid-1/#algo-find-fr-size
+		static constexpr void ResolveTrackOffsets(
+			const std::optional<GridTrackList>& track_list,
+			int explicit_count,
+			int count,
+			Px space,
+			Px gap,
+			std::vector<Px>& offsets
+		) noexcept {
+			const auto track_size = [&](int track) -> GridExplicitTrackSize {
+				if (track_list && track < static_cast<int>(track_list->sizes.size())) {
+					return track_list->sizes[track];
+				}
+				return GridFr{1};
+			};
+
+			Px fixed_space = 0;
+			float total_fr = 0;
+			for (int track = 0; track < explicit_count; ++track) {
+				std::visit([&](auto&& size) {
+					using T = std::decay_t<decltype(size)>;
+					if constexpr (std::is_same_v<T, GridFr>) {
+						total_fr += size.value;
+					}
+					else if constexpr (std::is_same_v<T, Percent>) {
+						fixed_space += space * size.value;
+					}
+					else {
+						fixed_space += size;
+					}
+				}, track_size(track));
+			}
+
+			const Px free_space = std::max(
+				space - fixed_space - gap * std::max(explicit_count - 1, 0),
+				0.0f
+			);
+			// flex factors summing to less than 1 only take that fraction
+			// of the free space
+			const Px fr_size = free_space / std::max(total_fr, 1.0f);
+
+			offsets.resize(count + 1);
+			offsets[0] = 0;
+			for (int track = 0; track < count; ++track) {
+				const auto size = track < explicit_count
+					? track_size(track)
+					: GridFr{1};
+				const Px length = std::visit([&](auto&& size) -> Px {
+					using T = std::decay_t<decltype(size)>;
+					if constexpr (std::is_same_v<T, GridFr>) {
+						return fr_size * size.value;
+					}
+					else if constexpr (std::is_same_v<T, Percent>) {
+						return space * size.value;
+					}
+					else {
+						return size;
+					}
+				}, size);
+				offsets[track + 1] = offsets[track] + length + gap;
+			}
+		}
+	};
+
+	/// @brief Grid layout
+	struct GridLayoutMode : LayoutMode, GridItemLayout {
 		constexpr GridLayoutMode() noexcept {}
 
 		void ComputeLayout(
-			std::shared_ptr<Element> el,
+			Element& el,
 			const PxRect& content_rect
 		) noexcept override;
 
-		constexpr auto GetExplicitGridSize() const noexcept -> Vector2<int> {
-			return explicit_grid_size;
+		/// @brief Lays out the children of node in a LayoutTree
+		void ComputeLayout(
+			LayoutTree& tree,
+			NodeHandle node,
+			const PxRect& content_rect
+		) noexcept;
+	};
+
+	// see https://www.w3.org/TR/css-grid-1/#auto-placement-algo
+	constexpr void GridItemLayout::ComputeItemRects(
+		const LayoutOptions& layout_options,
+		std::span<const GridItemPlacement> items,
+		const PxRect& content_rect
+	) noexcept {
+		const auto explicit_rows = std::max(
+			layout_options.num_rows,
+			row_track_list ? static_cast<int>(row_track_list->sizes.size()) : 0
+		);
+		const auto explicit_cols = std::max(
+			layout_options.num_columns,
+			col_track_list ? static_cast<int>(col_track_list->sizes.size()) : 0
+		);
+
+		this->explicit_grid_size = Vector2<int>{explicit_rows, explicit_cols};
+
+		const auto scratch_capacity = [&] {
+			return std::array{
+				occupancy.data.capacity(),
+				item_placements.capacity(),
+				item_areas.capacity(),
+				item_rects.capacity(),
+				col_offsets.capacity(),
+				row_offsets.capacity(),
+			};
+		};
+		const auto initial_capacity = scratch_capacity();
+		size_t probes = 0;
+
+		// one bit per cell, cells outside the grid are free
+		occupancy.reset(explicit_rows, explicit_cols);
+		item_areas.resize(items.size());
+
+		// 1. Position anything that's not auto-positioned
+		// place non-auto-positioned items
+		// as they are
+		for(size_t i = 0; i < items.size(); ++i) {
+			const auto& item_options = items[i];
+			if(!item_options.row_start || !item_options.col_start) {
+				continue;
+			}
+
+			const auto row_start = item_options.row_start.value();
+			const auto col_start = item_options.col_start.value();
+			const auto row_span = item_options.row_span;
+			const auto col_span = item_options.col_span;
+
+			occupancy.mark(row_start, row_span, col_start, col_span);
+			item_areas[i] = Vector2<Segment<int>>{
+				{col_start, col_span},
+				{row_start, row_span},
+			};
 		}
 
-		constexpr auto GetImplicitGridSize() const noexcept -> Vector2<int> {
-			return implicit_grid_size;
+		// 2. Process the items locked to a given row
+		// dense packing
+		// Set the column-start line of its placement to the earliest (smallest
+		// positive index) line index that ensures this item’s grid area will not
+		// overlap any occupied grid cells.
+		for(size_t i = 0; i < items.size(); ++i) {
+			const auto& item_options = items[i];
+			if(!item_options.row_start || item_options.col_start) {
+				continue;
+			}
+
+			const auto row_start = item_options.row_start.value();
+			const auto row_span = item_options.row_span;
+			const auto col_span = item_options.col_span;
+
+			// always found, since columns past the grid are free
+			const int col_start = occupancy.find_free(row_start, row_span, 0, col_span);
+			++probes;
+			occupancy.mark(row_start, row_span, col_start, col_span);
+			item_areas[i] = Vector2<Segment<int>>{
+				{col_start, col_span},
+				{row_start, row_span},
+			};
 		}
 
-	private:
-		Vector2<int> explicit_grid_size;
-		Vector2<int> implicit_grid_size;
-	};
-}
\ No newline at end of file
+		// 3. Position the remaining grid items.
+		int current_row = 0;
+		int current_col = 0;
+
+		for(size_t i = 0; i < items.size(); ++i){
+			const auto& item_options = items[i];
+			if(item_options.row_start) {
+				continue;
+			}
+
+			const auto col_start = item_options.col_start;
+			const auto row_span = item_options.row_span;
+			const auto col_span = item_options.col_span;
+
+			// If the item has a definite column position:
+			if(col_start) {
+				// Set the column position of the cursor to the grid item’s
+				// column-start line. If this is less than the previous column
+				// position of the cursor, increment the row position by 1.
+				if(*col_start < current_col) {
+					++current_row;
+				}
+				current_col = col_start.value();
+
+				// Increment the cursor's row position until a value is found where
+				// the grid item does not overlap any occupied grid cells (creating
+				// new rows in the implicit grid as necessary).
+				for(; ; ++current_row) {
+					++probes;
+					if(occupancy.is_free(current_row, row_span, current_col, col_span)){
+						occupancy.mark(current_row, row_span, current_col, col_span);
+						item_areas[i] = Vector2<Segment<int>>{
+							{current_col, col_span},
+							{current_row, row_span},
+						};
+						break;
+					}
+				}
+			}
+			// col_start == std::nullopt
+			// If the item has an automatic grid position in both axes:
+			else {
+				// Increment the column position of the auto-placement cursor until
+				// either this item’s grid area does not overlap any occupied grid
+				// cells, or the cursor’s column position, plus the item’s column
+				// span, overflow the number of columns in the implicit grid, as
+				// determined earlier in this algorithm.
+				//
+				// An item wider than the grid goes at the start of a row,
+				// growing the implicit grid.
+				const int col_limit = std::max(occupancy.num_cols, col_span);
+				for(;;){
+					const int free_col = occupancy.find_free(
+						current_row, row_span,
+						current_col, col_span,
+						col_limit
+					);
+					++probes;
+					if(free_col != OccupancyGrid::no_column){
+						current_col = free_col;
+						occupancy.mark(current_row, row_span, current_col, col_span);
+						item_areas[i] = Vector2<Segment<int>>{
+							{current_col, col_span},
+							{current_row, row_span},
+						};
+						break;
+					}
+					++current_row;
+					current_col = 0;
+				}
+			}
+		}
+
+		// calculate row and column sizes
+		// columns run along the main axis
+		const auto [main_gap, cross_gap] = ResolveGaps(
+			layout_options,
+			content_rect,
+			Axis::Horizontal
+		);
+
+		ResolveTrackOffsets(
+			col_track_list,
+			explicit_cols,
+			occupancy.num_cols,
+			content_rect.Width(),
+			main_gap,
+			col_offsets
+		);
+		ResolveTrackOffsets(
+			row_track_list,
+			explicit_rows,
+			occupancy.num_rows,
+			content_rect.Height(),
+			cross_gap,
+			row_offsets
+		);
+
+		// set item rects
+		item_rects.resize(items.size());
+		for(size_t i = 0; i < items.size(); ++i) {
+			const auto& cols = item_areas[i].Horizontal();
+			const auto& rows = item_areas[i].Vertical();
+
+			item_rects[i] = PxRect::FromXYWH(
+				content_rect.Horizontal().start + col_offsets[cols.start],
+				content_rect.Vertical().start + row_offsets[rows.start],
+				col_offsets[cols.End()] - col_offsets[cols.start] - main_gap,
+				row_offsets[rows.End()] - row_offsets[rows.start] - cross_gap
+			);
+		}
+
+		// item_placements is filled before this call, so its growth
+		// is only seen by the next layout
+		const auto final_capacity = scratch_capacity();
+		size_t growths = 0;
+		for(size_t i = 0; i < final_capacity.size(); ++i) {
+			growths += final_capacity[i] != initial_capacity[i];
+		}
+		CountLayoutStat(LayoutCounter::ScratchGrowths, growths);
+		CountLayoutStat(LayoutCounter::GridCellProbes, probes);
+
+		// set implicit grid size
+		this->implicit_grid_size = Vector2<int>{
+			occupancy.num_rows,
+			occupancy.num_cols,
+		};
+	}
+}
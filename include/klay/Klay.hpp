@@ -3,4 +3,12 @@
 #include <klay/Geometry.hpp>
 #include <klay/Element.hpp>
 #include <klay/ElementBuilder.hpp>
+#include <klay/ElementTreeBuilder.hpp>
+#include <klay/LayoutTree.hpp>
+#include <klay/LayoutSnapshot.hpp>
+#include <klay/LayoutTrace.hpp>
+#include <klay/Stats.hpp>
+#include <klay/ThreadPool.hpp>
+#include <klay/VirtualList.hpp>
+#include <klay/StaticLayout.hpp>
 #include <klay/ToString.hpp>
\ No newline at end of file
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <cstdint>
+#include <limits>
 #include <klay/Geometry.hpp>
 
 namespace Klay {
 	struct LayoutMode;
 	struct Element;
+	struct LayoutTree;
+
+	/// @brief Index of a node in a LayoutTree
+	using NodeHandle = std::uint32_t;
 
 	enum class Align {
 		Start,
@@ -38,10 +45,120 @@ namespace Klay {
 		int num_columns = 0;
 	};
 
+	/// @brief Resolves all four padding edges at once, percentages of
+	/// each axis against the length of basis along that axis
+	constexpr PxEdgeArea ResolvePadding(
+		const EdgeArea<Unit>& padding,
+		const PxSize& basis
+	) noexcept {
+		// edges in memory order, horizontal start and end then vertical,
+		// so the four multiply-adds are independent and vectorize
+		const float bases[4] {
+			basis.Horizontal(), basis.Horizontal(),
+			basis.Vertical(), basis.Vertical(),
+		};
+		float resolved[4] {};
+		for (int i = 0; i < 4; ++i) {
+			const Unit& unit = padding.axes[i / 2].edges[i % 2];
+			resolved[i] = unit.px + unit.fraction * bases[i];
+		}
+
+		PxEdgeArea result;
+		result.Horizontal() = EdgeLength<Px>{resolved[0], resolved[1]};
+		result.Vertical() = EdgeLength<Px>{resolved[2], resolved[3]};
+		return result;
+	}
+
+	/// @brief Shrinks rect by the padding in options.
+	/// Percentages are resolved against basis, the content box of the
+	/// parent, which min sizes reserve the padding against too.
+	constexpr PxRect ComputeContentRect(
+		const LayoutOptions& options,
+		const PxRect& rect,
+		const PxSize& basis
+	) noexcept {
+		return rect + ResolvePadding(options.padding, basis);
+	}
+
+	/// @brief Padding summed along each axis, with the px and percent
+	/// parts kept apart until the basis is known
+	struct PaddingSize {
+		PxSize px {0, 0};
+		// fraction of the basis along each axis
+		PxSize fraction {0, 0};
+
+		constexpr bool HasPercent() const noexcept {
+			return fraction.Horizontal().value != 0 || fraction.Vertical().value != 0;
+		}
+
+		constexpr PxSize Resolve(const PxSize& basis) const noexcept {
+			return PxSize{
+				px.Horizontal() + fraction.Horizontal().value * basis.Horizontal(),
+				px.Vertical() + fraction.Vertical().value * basis.Vertical(),
+			};
+		}
+	};
+
+	constexpr PaddingSize SumPadding(const EdgeArea<Unit>& padding) noexcept {
+		PaddingSize sum;
+		for (int axis = 0; axis < 2; ++axis) {
+			const auto& edges = padding.axes[axis];
+			sum.px.axes[axis] = Px{edges.Start().px + edges.End().px};
+			sum.fraction.axes[axis] = Px{edges.Start().fraction + edges.End().fraction};
+		}
+		return sum;
+	}
+
+	/// @brief Max size of items without one
+	constexpr PxSize unbounded_size {
+		Px{std::numeric_limits<float>::infinity()},
+		Px{std::numeric_limits<float>::infinity()},
+	};
+
+	/// @brief Clamps size between min and max, min winning over max
+	constexpr PxSize ClampSize(const PxSize& size, const PxSize& min, const PxSize& max) noexcept {
+		return size.Transform([&](Px length, Axis axis) {
+			return std::max(min.GetAxis(axis), std::min(length, max.GetAxis(axis)));
+		});
+	}
+
+	/// @brief Clamps size between min and max, min winning over max.
+	/// Items are laid out from their preferred size clamped this way, so
+	/// an axis without a preferred size leaves them at their min size.
+	constexpr PxSize ClampSize(const OptionalPxSize& size, const PxSize& min, const PxSize& max) noexcept {
+		return size.Transform([&](const std::optional<Px>& length, Axis axis) {
+			if(!length) {
+				return min.GetAxis(axis);
+			}
+			return std::max(min.GetAxis(axis), std::min(*length, max.GetAxis(axis)));
+		});
+	}
+
+	struct ResolvedGaps {
+		Px main;
+		Px cross;
+	};
+
+	/// @brief Resolves both gaps of options at once, main_gap against the
+	/// length of content_rect along main_axis and cross_gap against the
+	/// other axis
+	constexpr ResolvedGaps ResolveGaps(
+		const LayoutOptions& options,
+		const PxRect& content_rect,
+		Axis main_axis
+	) noexcept {
+		const Px main_basis = content_rect.GetAxis(main_axis).length;
+		const Px cross_basis = content_rect.GetAxis(CrossAxis(main_axis)).length;
+		return ResolvedGaps{
+			options.main_gap.Resolve(main_basis),
+			options.cross_gap.Resolve(cross_basis),
+		};
+	}
+
 	struct LayoutMode {
 		virtual ~LayoutMode() = default;
 		virtual void ComputeLayout(
-			std::shared_ptr<Element> el,
+			Element& el,
 			const PxRect& content_rect
 		) noexcept = 0;
 	};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <klay/Geometry.hpp>
+#include <klay/Layout.hpp>
+#include <klay/LayoutTree.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Klay {
+	/// @brief Header at the start of every snapshot
+	struct LayoutSnapshotHeader {
+		char magic[4];
+		std::uint32_t version;
+		// written as 0x01020304 in the byte order of the writer
+		std::uint32_t byte_order;
+		std::uint32_t num_nodes;
+		std::uint32_t num_containers;
+		std::uint32_t num_tracks;
+		std::uint32_t has_geometry;
+		std::uint32_t reserved;
+		// viewport the geometry was computed for
+		PxRect viewport;
+		// size of the whole snapshot, header included
+		std::uint64_t size;
+	};
+
+	/// @brief Placement of a grid item, with
+	/// layout_snapshot_auto_track for auto-placed axes
+	struct LayoutSnapshotPlacement {
+		std::int32_t row_start;
+		std::int32_t row_span;
+		std::int32_t col_start;
+		std::int32_t col_span;
+	};
+
+	/// @brief Track of a grid track list, kind being the index of the
+	/// alternative in GridExplicitTrackSize
+	struct LayoutSnapshotTrack {
+		std::uint32_t kind;
+		float value;
+	};
+
+	enum class LayoutSnapshotMode : std::uint8_t {
+		Flex,
+		Grid,
+	};
+
+	/// @brief Layout mode and options of a node with children
+	struct LayoutSnapshotContainer {
+		Unit main_gap;
+		Unit cross_gap;
+		// horizontal start and end, then vertical
+		Unit padding[4];
+		std::int32_t num_rows;
+		std::int32_t num_columns;
+
+		LayoutSnapshotMode mode;
+		std::uint8_t justify_content;
+		std::uint8_t align_items;
+		std::uint8_t justify_items;
+		// flex only
+		std::uint8_t main_axis;
+		std::uint8_t wrap;
+		// grid only, whether each track list is set
+		std::uint8_t has_row_tracks;
+		std::uint8_t has_col_tracks;
+
+		// the row tracks are tracks [first_track, first_track + num_row_tracks),
+		// and the column tracks follow them
+		std::uint32_t first_track;
+		std::uint32_t num_row_tracks;
+		std::uint32_t num_col_tracks;
+	};
+
+	constexpr std::int32_t layout_snapshot_auto_track = std::numeric_limits<std::int32_t>::min();
+	constexpr std::uint8_t layout_snapshot_no_align = 0xFF;
+	constexpr float layout_snapshot_no_size = std::numeric_limits<float>::quiet_NaN();
+
+	/// @brief Read only view of a LayoutTree stored in a byte buffer.
+	///
+	/// The buffer is a header followed by one section per array of the
+	/// tree, each starting at a multiple of alignment, so a mapped file
+	/// is used in place: opening checks the header, the size and the
+	/// containers, without reading the per node arrays, and the arrays
+	/// below point into the buffer. Snapshots may also hold the geometry
+	/// of the tree for one viewport, which is then read without running
+	/// layout.
+	///
+	/// Snapshots are only read by builds with the same version, byte
+	/// order and float format as the writer. The per node arrays are
+	/// trusted, so only open snapshots written by Write.
+	class LayoutSnapshot {
+	public:
+		static constexpr char magic[4] { 'K', 'L', 'S', 'N' };
+		static constexpr std::uint32_t version = 3;
+		/// @brief Alignment of the buffer and of each section
+		static constexpr size_t alignment = 16;
+
+		/// @brief Serializes tree
+		/// @param viewport if set, tree is laid out in a copy of itself
+		/// and the geometry is stored for viewport
+		static std::vector<std::byte> Write(
+			const LayoutTree& tree,
+			const std::optional<PxRect>& viewport = std::nullopt
+		);
+
+		/// @brief Opens a snapshot in place. data must outlive the snapshot.
+		/// @return nullopt if data is not aligned to alignment, does not start
+		/// with a header this build can read, is shorter than the header says,
+		/// or has a container with an unknown mode or tracks out of range
+		static std::optional<LayoutSnapshot> Open(std::span<const std::byte> data) noexcept;
+
+		// arrays of the tree, see LayoutTree
+		std::span<const NodeHandle> parent;
+		std::span<const NodeHandle> first_child;
+		std::span<const NodeHandle> num_children;
+		std::span<const PxSize> min_size;
+		// layout_snapshot_no_size on the axes without a preferred size
+		std::span<const PxSize> preferred_size;
+		std::span<const PxSize> max_size;
+		std::span<const PxSize> padding_size;
+		std::span<const PxSize> padding_fraction;
+		std::span<const float> grow;
+		std::span<const float> shrink;
+		// layout_snapshot_no_align without an align-self
+		std::span<const std::uint8_t> align_self;
+		std::span<const LayoutSnapshotPlacement> grid_placement;
+		std::span<const std::uint8_t> limited_children;
+		std::span<const NodeHandle> container;
+		std::span<const LayoutSnapshotContainer> containers;
+		std::span<const LayoutSnapshotTrack> tracks;
+		// empty without geometry
+		std::span<const PxRect> computed_rect;
+
+		constexpr size_t Size() const noexcept {
+			return parent.size();
+		}
+
+		constexpr bool HasGeometry() const noexcept {
+			return !computed_rect.empty();
+		}
+
+		/// @brief Viewport the geometry was computed for
+		constexpr const PxRect& GetViewport() const noexcept {
+			return viewport;
+		}
+
+		/// @brief Rects of the nodes laid out in viewport, read in place
+		/// @return the stored geometry if it was computed for viewport,
+		/// otherwise an empty span, in which case lay out ToLayoutTree
+		std::span<const PxRect> RectsFor(const PxRect& viewport) const noexcept;
+
+		OptionalPxSize GetPreferredSize(NodeHandle node) const noexcept;
+		std::optional<Align> GetAlignSelf(NodeHandle node) const noexcept;
+		GridItemPlacement GetGridPlacement(NodeHandle node) const noexcept;
+		// node must have a container, as nodes with children do
+		LayoutOptions GetLayoutOptions(NodeHandle node) const noexcept;
+		LayoutTree::LayoutModeVariant GetLayoutMode(NodeHandle node) const;
+
+		/// @brief Copies the snapshot into a tree, to lay it out in other
+		/// viewports. Arrays are copied whole, and only grid containers
+		/// allocate on their own, for their track lists.
+		LayoutTree ToLayoutTree() const;
+
+	private:
+		PxRect viewport;
+	};
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <klay/Geometry.hpp>
+#include <klay/Layout.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Layout traces record how a program builds, changes and lays out its
+// element trees, so that a slow frame can be replayed and profiled away
+// from the program. Recording is opt-in at runtime: until
+// StartLayoutTrace is called, each hook is a single relaxed load.
+//
+// Elements are recorded with their options and subtree the first time
+// the trace refers to them, so recording can start with the trees
+// already built. From then on, AddChild, ElementTreeBuilder::Build and
+// MarkDirty, which the setters call, record changes to them.
+//
+// Measure functions and custom layout modes cannot be recorded. Their
+// elements are replayed without them.
+
+namespace Klay {
+	class ThreadPool;
+
+	enum class LayoutTraceCallKind : std::uint8_t {
+		// Element::ComputeLayout
+		Layout,
+		// the overloads of Element::ComputeTreeLayout
+		TreeLayout,
+		ParallelTreeLayout,
+		DamageTreeLayout,
+	};
+
+	/// @brief Layout call of a trace
+	struct LayoutTraceCall {
+		LayoutTraceCallKind kind;
+		// index of the element the call was made on,
+		// in the order elements were first recorded
+		std::uint32_t element;
+		PxRect rect;
+		// time the call took when it was recorded
+		std::chrono::nanoseconds recorded_time {0};
+		// time the call took in ReplayLayoutTrace
+		std::chrono::nanoseconds replay_time {0};
+	};
+
+	/// @brief Starts recording a new trace, dropping any trace in progress
+	void StartLayoutTrace();
+
+	/// @brief Stops recording
+	/// @return the trace recorded since StartLayoutTrace,
+	/// or nothing if no trace was in progress
+	std::vector<std::byte> StopLayoutTrace();
+
+	namespace Detail {
+		extern std::atomic<bool> layout_trace_recording;
+
+		// called by Element and ElementTreeBuilder while recording
+		void TraceAddChild(const Element& parent, const Element& child);
+		void TraceMarkDirty(const Element& element);
+		// records the call and returns its index, or -1 for calls
+		// made within another call
+		std::ptrdiff_t BeginTraceCall(
+			LayoutTraceCallKind kind,
+			const Element& element,
+			const PxRect& rect,
+			std::uint32_t min_parallel_size
+		);
+		void EndTraceCall(std::ptrdiff_t call, std::chrono::nanoseconds elapsed) noexcept;
+	}
+
+	inline bool IsLayoutTraceRecording() noexcept {
+		return Detail::layout_trace_recording.load(std::memory_order_relaxed);
+	}
+
+	/// @brief Records a layout call for its lifetime, if recording.
+	/// Calls made within another call on the same thread are not recorded,
+	/// since replaying the outer call makes them again.
+	class LayoutTraceScope {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		LayoutTraceScope(
+			LayoutTraceCallKind kind,
+			const Element& element,
+			const PxRect& rect,
+			size_t min_parallel_size = 0
+		) {
+			if (IsLayoutTraceRecording()) {
+				call = Detail::BeginTraceCall(
+					kind,
+					element,
+					rect,
+					static_cast<std::uint32_t>(min_parallel_size)
+				);
+				start = Clock::now();
+			}
+		}
+
+		LayoutTraceScope(const LayoutTraceScope&) = delete;
+		LayoutTraceScope& operator=(const LayoutTraceScope&) = delete;
+
+		~LayoutTraceScope() {
+			if (call >= 0) {
+				Detail::EndTraceCall(
+					call,
+					std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start)
+				);
+			}
+		}
+
+	private:
+		std::ptrdiff_t call = -1;
+		Clock::time_point start;
+	};
+
+	/// @brief Builds the elements of trace and makes its layout calls,
+	/// timing each one
+	/// @param pool runs the calls recorded with a thread pool,
+	/// which run serially without one
+	/// @param elements if not null, filled with the replayed elements
+	/// in the order they were first recorded
+	/// @return the layout calls in order, or nullopt if trace was
+	/// not recorded by this version or is cut short
+	std::optional<std::vector<LayoutTraceCall>> ReplayLayoutTrace(
+		std::span<const std::byte> trace,
+		ThreadPool* pool = nullptr,
+		std::vector<std::shared_ptr<Element>>* elements = nullptr
+	);
+}
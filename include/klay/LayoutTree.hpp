@@ -0,0 +1,160 @@
+#pragma once
+
+#include <klay/Geometry.hpp>
+#include <klay/Layout.hpp>
+#include <klay/Flex.hpp>
+#include <klay/Grid.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <variant>
+#include <optional>
+#include <limits>
+
+namespace Klay {
+	/// @brief Flat element store laid out without pointer chasing.
+	///
+	/// Nodes live in index order, and the children of a node always occupy
+	/// a contiguous range of handles after their parent. The fields read by
+	/// the layout modes are kept in separate arrays, so layout walks
+	/// memory sequentially.
+	///
+	/// Only the built-in flex and grid layout modes are supported.
+	struct LayoutTree {
+		static constexpr NodeHandle null_handle = std::numeric_limits<NodeHandle>::max();
+
+		using LayoutModeVariant = std::variant<FlexLayoutMode, GridLayoutMode>;
+
+		/// @brief Layout options and mode of a node with children.
+		/// The grid state is several times the size of the rest, so grid
+		/// containers keep it in grids and flex containers do not pay for it.
+		struct Container {
+			LayoutOptions layout_options;
+			// unused by grid containers
+			FlexLayoutMode flex;
+			// index into grids, or null_handle for flex containers
+			NodeHandle grid = null_handle;
+			// content box of the last layout, which the percent padding
+			// of the children resolves against
+			PxSize content_size {0, 0};
+		};
+
+		// topology
+		std::vector<NodeHandle> parent;
+		std::vector<NodeHandle> first_child;
+		std::vector<NodeHandle> num_children;
+
+		// hot fields
+		std::vector<PxSize> min_size;
+		// unset on the axes without a preferred size, see ClampSize.
+		// Set with SetSizeLimits.
+		std::vector<OptionalPxSize> preferred_size;
+		// unbounded_size without a max size
+		std::vector<PxSize> max_size;
+		// sum of the px padding along each axis
+		std::vector<PxSize> padding_size;
+		// sum of the percent padding along each axis, as fractions of
+		// the content box of the parent, see PaddingSize
+		std::vector<PxSize> padding_fraction;
+		std::vector<float> grow;
+		std::vector<float> shrink;
+		std::vector<std::optional<Align>> align_self;
+		std::vector<GridItemPlacement> grid_placement;
+
+		// whether any child was given a preferred or max size. Without
+		// one, children are laid out from their min size and not clamped,
+		// and the layout does not read their size limits at all.
+		std::vector<std::uint8_t> limited_children;
+		// whether any child has percent padding, updated by ComputeMinSize
+		std::vector<std::uint8_t> percent_padding_children;
+
+		// intrinsic min size, with percent padding left unresolved.
+		// The layout pass resolves it for nodes with percent padding,
+		// once the content box of their parent is known.
+		std::vector<PxSize> computed_min_size;
+		std::vector<PxSize> computed_size;
+		std::vector<PxPoint> computed_position;
+
+		// index into containers, or null_handle for nodes without
+		// a layout mode
+		std::vector<NodeHandle> container;
+		std::vector<Container> containers;
+		std::vector<GridLayoutMode> grids;
+
+		/// @brief Flattens the tree rooted at root.
+		/// Elements are stored in breadth first order, with root at handle 0.
+		/// Measure functions are not carried over, and nodes keep the px
+		/// sizes of size. Percentages of size are left unresolved, as in
+		/// the intrinsic sizing of Element. Percent padding is kept, and
+		/// resolves as in Element.
+		/// @param elements if not null, filled with the element of each handle
+		static LayoutTree FromElement(
+			const Element& root,
+			std::vector<const Element*>* elements = nullptr
+		);
+
+		void Reserve(size_t count);
+
+		constexpr size_t Size() const noexcept {
+			return parent.size();
+		}
+
+		/// @brief Adds a node without a parent
+		NodeHandle AddRoot();
+
+		/// @brief Adds all children of parent at once.
+		/// Must be called at most once per node.
+		/// @return the handle of the first child, the rest follow it
+		NodeHandle AddChildren(NodeHandle parent, NodeHandle count);
+
+		/// @brief Sets the preferred and max size of node,
+		/// which must already be added to its parent
+		void SetSizeLimits(
+			NodeHandle node,
+			const OptionalPxSize& preferred,
+			const PxSize& max = unbounded_size
+		) noexcept;
+
+		/// @brief Sets the layout mode of node, adding a container for it
+		/// if it has none. The grid of a grid container that becomes a
+		/// flex container is left unused in grids.
+		void SetLayoutMode(
+			NodeHandle node,
+			LayoutModeVariant mode,
+			const LayoutOptions& options = {}
+		);
+
+		/// @brief Adds a container without assigning it to a node
+		/// @return its index in containers
+		NodeHandle AddContainer(LayoutModeVariant mode, const LayoutOptions& options);
+
+		/// @brief The layout mode of the container of node
+		LayoutModeVariant GetLayoutMode(NodeHandle node) const;
+
+		const LayoutOptions& GetLayoutOptions(NodeHandle node) const noexcept {
+			return containers[container[node]].layout_options;
+		}
+
+		LayoutOptions& GetLayoutOptions(NodeHandle node) noexcept {
+			return containers[container[node]].layout_options;
+		}
+
+		PxRect ComputedRect(NodeHandle node) const noexcept {
+			return PxRect::FromPointSize(
+				computed_position[node],
+				computed_size[node]
+			);
+		}
+
+		/// @brief Computes the min size of every node, bottom up
+		void ComputeMinSize() noexcept;
+
+		/// @brief Min size of node from the min sizes of its children,
+		/// with padding, the sum of its padding along each axis
+		PxSize MinSizeForPadding(NodeHandle node, const PxSize& padding) const noexcept;
+
+		/// @brief Computes min sizes, then lays out every node top down.
+		/// Roots are given rect as their computed rect.
+		void ComputeLayout(const PxRect& rect) noexcept;
+	};
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <klay/Geometry.hpp>
+#include <klay/Layout.hpp>
+#include <klay/Flex.hpp>
+#include <klay/Grid.hpp>
+
+#include <array>
+#include <optional>
+#include <span>
+
+namespace Klay {
+	enum class StaticLayoutKind {
+		None,
+		Flex,
+		Grid,
+	};
+
+	/// @brief Element of a tree whose structure is known at compile time.
+	/// Elements refer to their parent by index, and a parent must come
+	/// before its children. Children are laid out in index order.
+	///
+	/// Only what Element can express through these fields is supported,
+	/// and the rest has no field, so it cannot be set by mistake:
+	/// - flex containers never wrap, as with FlexWrap::NoWrap
+	/// - grids have no track lists, so their num_rows by num_columns
+	///   explicit tracks share the content box equally
+	/// - min, preferred and max sizes are in pixels, without percentages
+	/// - there are no measure functions or custom layout modes
+	///
+	/// Percent padding and gaps are supported, and resolve as in Element.
+	struct StaticElement {
+		int parent = -1;
+		PxSize min_size {0, 0};
+		// see ClampSize
+		OptionalPxSize preferred_size {};
+		PxSize max_size = unbounded_size;
+
+		StaticLayoutKind layout = StaticLayoutKind::None;
+		// flex only, items are laid out on a single line
+		Axis main_axis = Axis::Horizontal;
+		LayoutOptions layout_options;
+
+		// item options
+		float grow = 0;
+		float shrink = 0;
+		std::optional<Align> align_self;
+		GridItemPlacement placement;
+	};
+
+	namespace Detail {
+		// Accessor over the children of one static container,
+		// see ComputeFlexLine
+		template<size_t N>
+		struct StaticFlexItems {
+			const std::array<StaticElement, N>& elements;
+			std::span<const size_t> children;
+			const std::array<PxSize, N>& min_size;
+			std::array<PxSize, N>& size;
+			std::array<PxPoint, N>& position;
+
+			constexpr size_t Size() const noexcept {
+				return children.size();
+			}
+
+			constexpr PxSize MinSize(size_t i) const noexcept {
+				return min_size[children[i]];
+			}
+
+			constexpr PxSize PreferredSize(size_t i) const noexcept {
+				const auto& element = elements[children[i]];
+				return ClampSize(element.preferred_size, min_size[children[i]], element.max_size);
+			}
+
+			constexpr PxSize MaxSize(size_t i) const noexcept {
+				const auto& element = elements[children[i]];
+				return ClampSize(element.max_size, min_size[children[i]], element.max_size);
+			}
+
+			constexpr float Grow(size_t i) const noexcept {
+				return elements[children[i]].grow;
+			}
+
+			constexpr float Shrink(size_t i) const noexcept {
+				return elements[children[i]].shrink;
+			}
+
+			constexpr std::optional<Align> AlignSelf(size_t i) const noexcept {
+				return elements[children[i]].align_self;
+			}
+
+			constexpr PxSize& ComputedSize(size_t i) const noexcept {
+				return size[children[i]];
+			}
+
+			constexpr PxPoint& ComputedPosition(size_t i) const noexcept {
+				return position[children[i]];
+			}
+		};
+	}
+
+	/// @brief Lays out a static tree with the same algorithms as Element.
+	/// Runs at compile time when the arguments are constants.
+	///
+	/// The result matches an Element tree with the same options, within
+	/// the limits listed on StaticElement: no wrapping, no grid track
+	/// lists, and sizes only in pixels.
+	/// @return the rect of each element, elements without a parent
+	/// are given viewport
+	template<size_t N>
+	constexpr std::array<PxRect, N> ComputeStaticLayout(
+		const std::array<StaticElement, N>& elements,
+		const PxRect& viewport
+	) noexcept {
+		// children of element i are children[first_child[i], first_child[i + 1])
+		std::array<size_t, N + 1> first_child {};
+		for (const auto& element : elements) {
+			if (element.parent >= 0) {
+				++first_child[element.parent + 1];
+			}
+		}
+		for (size_t i = 0; i < N; ++i) {
+			first_child[i + 1] += first_child[i];
+		}
+		std::array<size_t, N> children {};
+		std::array<size_t, N> num_children {};
+		for (size_t i = 0; i < N; ++i) {
+			const int parent = elements[i].parent;
+			if (parent >= 0) {
+				children[first_child[parent] + num_children[parent]++] = i;
+			}
+		}
+
+		// min size of element i with padding, the sum of its padding
+		// along each axis, see LayoutTree::MinSizeForPadding
+		std::array<PxSize, N> min_size {};
+		const auto min_size_for_padding = [&](size_t i, const PxSize& padding) {
+			PxSize computed {0, 0};
+			for (size_t c = first_child[i]; c < first_child[i + 1]; ++c) {
+				computed += min_size[children[c]];
+			}
+			computed += padding;
+			for (int axis = 0; axis < 2; ++axis) {
+				computed.axes[axis] = std::max(
+					computed.axes[axis],
+					elements[i].min_size.axes[axis]
+				);
+			}
+			return computed;
+		};
+
+		// children always come after their parent,
+		// so a reverse sweep visits children first.
+		// Percent padding is resolved in the layout sweep.
+		for (size_t i = N; i-- > 0;) {
+			min_size[i] = min_size_for_padding(i, SumPadding(elements[i].layout_options.padding).px);
+		}
+
+		// parents always come before their children,
+		// so a forward sweep visits each element after its rect is assigned
+		std::array<PxSize, N> size {};
+		std::array<PxPoint, N> position {};
+		std::array<GridItemPlacement, N> placements {};
+		// content box of each container, see LayoutTree::Container
+		std::array<PxSize, N> content_size {};
+		for (size_t i = 0; i < N; ++i) {
+			const auto& element = elements[i];
+			if (element.parent < 0) {
+				position[i] = PxPoint{viewport.X(), viewport.Y()};
+				size[i] = PxSize{viewport.Width(), viewport.Height()};
+			}
+			const auto first = first_child[i];
+			const auto count = first_child[i + 1] - first;
+			if (element.layout == StaticLayoutKind::None || count == 0) {
+				continue;
+			}
+
+			// percent padding resolves against the content box of the
+			// parent, or against the rect of a root
+			const bool laid_out = element.parent >= 0
+				&& elements[element.parent].layout != StaticLayoutKind::None;
+			const auto content_rect = ComputeContentRect(
+				element.layout_options,
+				PxRect::FromPointSize(position[i], size[i]),
+				laid_out ? content_size[element.parent] : size[i]
+			);
+			content_size[i] = PxSize{content_rect.Width(), content_rect.Height()};
+			const std::span<const size_t> item_children{children.data() + first, count};
+			for (const auto child : item_children) {
+				const auto padding = SumPadding(elements[child].layout_options.padding);
+				if (padding.HasPercent()) {
+					min_size[child] = min_size_for_padding(child, padding.Resolve(content_size[i]));
+				}
+			}
+
+			if (element.layout == StaticLayoutKind::Flex) {
+				ComputeFlexLine(
+					element.main_axis,
+					element.layout_options,
+					content_rect,
+					Detail::StaticFlexItems<N>{elements, item_children, min_size, size, position}
+				);
+			}
+			else {
+				for (size_t c = 0; c < count; ++c) {
+					placements[c] = elements[item_children[c]].placement;
+				}
+				GridItemLayout grid;
+				grid.ComputeItemRects(
+					element.layout_options,
+					std::span{placements.data(), count},
+					content_rect
+				);
+				const auto item_rects = grid.GetItemRects();
+				for (size_t c = 0; c < count; ++c) {
+					const auto item = item_children[c];
+					const auto rect = FitGridItem(
+						item_rects[c],
+						elements[item].preferred_size,
+						min_size[item],
+						elements[item].max_size
+					);
+					size[item] = PxSize{rect.Width(), rect.Height()};
+					position[item] = PxPoint{rect.X(), rect.Y()};
+				}
+			}
+		}
+
+		std::array<PxRect, N> rects {};
+		for (size_t i = 0; i < N; ++i) {
+			rects[i] = PxRect::FromPointSize(position[i], size[i]);
+		}
+		return rects;
+	}
+
+	/// @brief Static tree with its layout precomputed for one viewport.
+	/// Declared constexpr, the rects are baked into the binary and no
+	/// layout runs at startup. Other viewports fall back to computing
+	/// the layout at runtime.
+	template<size_t N>
+	struct StaticLayout {
+		std::array<StaticElement, N> elements;
+		PxRect viewport;
+		std::array<PxRect, N> rects;
+
+		constexpr StaticLayout(
+			const std::array<StaticElement, N>& elements,
+			const PxRect& viewport
+		) noexcept
+			: elements{elements}
+			, viewport{viewport}
+			, rects{ComputeStaticLayout(elements, viewport)}
+		{}
+
+		/// @brief Rects of the elements laid out in the given viewport
+		constexpr std::array<PxRect, N> RectsFor(const PxRect& other) const noexcept {
+			if (other == viewport) {
+				return rects;
+			}
+			return ComputeStaticLayout(elements, other);
+		}
+	};
+}
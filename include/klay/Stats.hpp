@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+
+// Layout statistics are only collected when the library is built with
+// KLAY_STATS=1 (the KLAY_STATS CMake option). Otherwise every recording
+// call compiles to nothing and GetLayoutStats returns zeros.
+#ifndef KLAY_STATS
+#define KLAY_STATS 0
+#endif
+
+namespace Klay {
+	inline constexpr bool layout_stats_enabled = KLAY_STATS != 0;
+
+	enum class LayoutCounter {
+		// elements passed to Element::ComputeLayout, or nodes swept by
+		// LayoutTree::ComputeLayout
+		ElementsVisited,
+		// min sizes recomputed because the element was dirty
+		MinSizeComputes,
+		// layouts skipped or made by Element, see Element::IsLayoutCached
+		LayoutCacheHits,
+		LayoutCacheMisses,
+		// layout mode invocations, of any type
+		LayoutModeCalls,
+		FlexLayoutCalls,
+		GridLayoutCalls,
+		// occupancy queries made while placing grid items,
+		// each tests a candidate area against the occupied cells
+		GridCellProbes,
+		// scratch buffers and line caches of the layout modes that grew:
+		// the grid scratch, the flex line and freeze scratch, and the
+		// lines and children cached by wrapped flex containers. Other
+		// allocations, such as children vectors, are not counted
+		ScratchGrowths,
+		// measure function calls that missed the measure cache
+		MeasureCalls,
+		Count,
+	};
+
+	enum class LayoutPhase {
+		MinSize,
+		Layout,
+		Count,
+	};
+
+	/// @brief Snapshot of the layout counters and phase timings
+	/// since the last ResetLayoutStats
+	struct LayoutStats {
+		size_t elements_visited = 0;
+		size_t min_size_computes = 0;
+		size_t layout_cache_hits = 0;
+		size_t layout_cache_misses = 0;
+		size_t layout_mode_calls = 0;
+		size_t flex_layout_calls = 0;
+		size_t grid_layout_calls = 0;
+		size_t grid_cell_probes = 0;
+		size_t scratch_growths = 0;
+		size_t measure_calls = 0;
+
+		// time spent in the outermost call of each phase.
+		// Layout time includes min sizes computed during layout.
+		std::chrono::nanoseconds min_size_time {0};
+		std::chrono::nanoseconds layout_time {0};
+	};
+
+	/// @brief Safe to call while another thread lays out, the counters
+	/// are read individually
+	LayoutStats GetLayoutStats() noexcept;
+	void ResetLayoutStats() noexcept;
+
+	void AddLayoutStat(LayoutCounter counter, size_t n) noexcept;
+	bool BeginLayoutPhase(LayoutPhase phase) noexcept;
+	void EndLayoutPhase(
+		LayoutPhase phase,
+		bool outermost,
+		std::chrono::nanoseconds elapsed
+	) noexcept;
+
+	/// @brief Adds n to a counter. Does nothing in constant evaluation,
+	/// so constexpr layout code can record stats.
+	constexpr void CountLayoutStat(LayoutCounter counter, size_t n = 1) noexcept {
+		if constexpr (layout_stats_enabled) {
+			if (!std::is_constant_evaluated()) {
+				AddLayoutStat(counter, n);
+			}
+		}
+	}
+
+	namespace Detail {
+		template<bool enabled>
+		class LayoutPhaseTimer {
+		public:
+			using Clock = std::chrono::steady_clock;
+
+			explicit LayoutPhaseTimer(LayoutPhase phase) noexcept
+				: phase{phase}
+				, outermost{BeginLayoutPhase(phase)}
+			{
+				if (outermost) {
+					start = Clock::now();
+				}
+			}
+
+			LayoutPhaseTimer(const LayoutPhaseTimer&) = delete;
+			LayoutPhaseTimer& operator=(const LayoutPhaseTimer&) = delete;
+
+			~LayoutPhaseTimer() {
+				const auto elapsed = outermost
+					? Clock::now() - start
+					: Clock::duration{0};
+				EndLayoutPhase(
+					phase,
+					outermost,
+					std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+				);
+			}
+
+		private:
+			LayoutPhase phase;
+			bool outermost;
+			Clock::time_point start;
+		};
+
+		// an empty object when stats are off
+		template<>
+		class LayoutPhaseTimer<false> {
+		public:
+			explicit LayoutPhaseTimer(LayoutPhase) noexcept {}
+
+			LayoutPhaseTimer(const LayoutPhaseTimer&) = delete;
+			LayoutPhaseTimer& operator=(const LayoutPhaseTimer&) = delete;
+		};
+	}
+
+	/// @brief Times a layout phase for its lifetime.
+	/// Nested timers of the same phase on a thread are not counted,
+	/// so recursive calls can each hold one.
+	using LayoutPhaseTimer = Detail::LayoutPhaseTimer<layout_stats_enabled>;
+}
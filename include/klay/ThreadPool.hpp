@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Klay {
+	/// @brief Work-stealing thread pool used for parallel layout.
+	///
+	/// Each worker owns a task deque. Workers take tasks from the back of
+	/// their own deque and steal from the front of the others, so a worker
+	/// keeps the subtree it split locally while idle workers take the
+	/// largest remaining pieces.
+	class ThreadPool {
+	public:
+		/// @brief Tracks the unfinished tasks spawned into it
+		class TaskGroup {
+		public:
+			TaskGroup() = default;
+			TaskGroup(const TaskGroup&) = delete;
+			TaskGroup& operator=(const TaskGroup&) = delete;
+
+		private:
+			friend class ThreadPool;
+			std::atomic<size_t> pending = 0;
+		};
+
+		static size_t DefaultNumThreads() noexcept;
+
+		/// @param num_threads number of workers. With 0 workers, tasks
+		/// run on the thread that waits for them.
+		explicit ThreadPool(size_t num_threads = DefaultNumThreads());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		size_t NumThreads() const noexcept {
+			return threads.size();
+		}
+
+		/// @brief Queues a task on the deque of the calling worker,
+		/// or on the shared deque if called from outside the pool
+		void Spawn(TaskGroup& group, std::function<void()> task);
+
+		/// @brief Runs queued tasks until every task of group has finished,
+		/// sleeping while there are none to run.
+		/// Tasks may spawn and wait on their own groups.
+		void Wait(TaskGroup& group) noexcept;
+
+	private:
+		struct Task {
+			TaskGroup* group;
+			std::function<void()> run;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		// one per worker, the last is shared by threads outside the pool
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+
+		std::atomic<size_t> num_queued = 0;
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		size_t HomeQueue() const noexcept;
+		bool RunOne(size_t home) noexcept;
+		void WorkerLoop(size_t index) noexcept;
+	};
+}
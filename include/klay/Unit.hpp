@@ -1,6 +1,8 @@
 #pragma once
 
 #include <variant>
+#include <optional>
+#include <type_traits>
 
 #define KLAY_DEFINE_BINOP_FOR_UNIT(T, Value, Underlying, ArgT, argv, Op)\
 	constexpr T operator Op (ArgT) const noexcept { return value Op argv; }\
@@ -41,39 +43,69 @@ namespace Klay {
 
 	enum class Axis;
 
+	/// @brief A px or percent length, stored as px + fraction * basis.
+	/// A px length only sets px and a percent length only sets fraction,
+	/// so resolving is the same multiply-add for both, without branching
+	/// on the kind of length.
+	///
+	/// A zero percent length is indistinguishable from, and reported as,
+	/// a zero px length.
 	struct Unit {
-		std::variant<Px, Percent> value;
+		float px = 0;
+		float fraction = 0;
 
-		constexpr Unit() : value{Px{0}} {}
-		constexpr Unit(Px v) : value{v} {}
-		constexpr Unit(Percent v) : value{v} {}
+		constexpr Unit() = default;
+		constexpr Unit(Px v) : px{v.value} {}
+		constexpr Unit(Percent v) : fraction{v.value} {}
 
+		/// @brief Resolves percentages against basis
+		constexpr Px Resolve(Px basis) const noexcept {
+			return px + fraction * basis.value;
+		}
+
+		/// @brief Resolves percentages against the length of rect along axis
 		Px CalculatePx(const Rect<Px>& rect, Axis axis) const noexcept;
 
 		template<typename T>
 		constexpr bool Is() const noexcept {
-			return std::holds_alternative<T>(value);
-		}
-
-		template<typename T>
-		constexpr const T& Get() const noexcept(false) {
-			return std::get<T>(value);
+			if constexpr (std::is_same_v<T, Px>) {
+				return fraction == 0;
+			}
+			else {
+				static_assert(std::is_same_v<T, Percent>);
+				return fraction != 0;
+			}
 		}
 
 		template<typename T>
-		constexpr T& Get() noexcept(false) {
-			return std::get<T>(value);
+		constexpr T Get() const noexcept(false) {
+			if (!Is<T>()) {
+				throw std::bad_variant_access{};
+			}
+			return Value<T>();
 		}
 
 		template<typename T>
 		constexpr std::optional<T> TryGet() const noexcept {
-			auto v = std::get_if<T>(&value);
-			return v ? std::optional{*v} : std::nullopt;
+			return Is<T>() ? std::optional{Value<T>()} : std::nullopt;
 		}
 
 		template<typename F>
 		constexpr auto Visit(F&& f) const {
-			return std::visit(f, value);
+			return Is<Px>() ? f(Px{px}) : f(Percent{fraction});
+		}
+
+		constexpr bool operator==(const Unit&) const noexcept = default;
+
+	private:
+		template<typename T>
+		constexpr T Value() const noexcept {
+			if constexpr (std::is_same_v<T, Px>) {
+				return Px{px};
+			}
+			else {
+				return Percent{fraction};
+			}
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <klay/Layout.hpp>
+#include <klay/Geometry.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Klay {
+	/// @brief Extents of a sequence of rows in a Fenwick tree, so that the
+	/// offset of a row and the row at an offset are found in O(log n).
+	/// Sums are kept in double so repeated updates do not drift.
+	struct ExtentTree {
+		constexpr static size_t npos = static_cast<size_t>(-1);
+
+		constexpr size_t size() const noexcept {
+			return extents.size();
+		}
+
+		/// @brief Replaces every row with count rows of the given extent
+		void assign(size_t count, Px extent);
+
+		/// @brief Adds or removes rows at the end,
+		/// new rows have the given extent
+		void resize(size_t count, Px extent);
+
+		void push_back(Px extent);
+
+		Px get(size_t index) const noexcept {
+			return extents[index];
+		}
+
+		void set(size_t index, Px extent) noexcept;
+
+		/// @brief Sum of the extents of the first count rows,
+		/// which is the offset of row count
+		Px offset(size_t count) const noexcept;
+
+		Px total() const noexcept {
+			return offset(size());
+		}
+
+		/// @brief Index of the row containing offset. Offsets before the
+		/// first row give 0, offsets past the last row give size().
+		size_t find(Px offset) const noexcept;
+
+	private:
+		std::vector<Px> extents;
+		// 1-based Fenwick tree, tree[i] sums the rows
+		// [i - lowbit(i), i)
+		std::vector<double> tree;
+	};
+
+	/// @brief Lays out a long list of rows, only materializing the rows
+	/// in the visible window plus overscan.
+	///
+	/// Rows are stacked along axis and stretched across the content box.
+	/// Each layout asks provide_item for rows entering the window, and
+	/// reuses the elements of rows that stay in it, so the children of the
+	/// element always hold exactly the window. Once materialized, a row's
+	/// extent is measured from its min size and replaces the estimate.
+	///
+	/// After changing the scroll offset, item count or an extent, call
+	/// MarkLayoutDirty on the list element. These only move rows, so the
+	/// min sizes up to the root stay valid. Rows are measured by the layout.
+	struct VirtualListLayoutMode : LayoutMode {
+		/// @brief Returns the element for a row entering the window.
+		/// Required, debug builds assert it is set. Rows it returns
+		/// null for are laid out as empty elements.
+		using ProvideItem = std::function<std::shared_ptr<Element>(size_t index)>;
+		/// @brief Receives the element of a row leaving the window,
+		/// for example to pool it
+		using RecycleItem = std::function<void(size_t index, std::shared_ptr<Element> element)>;
+
+		Axis axis;
+		// extent of rows that were never materialized
+		Px estimated_extent;
+		// offset of the window from the start of the first row
+		Px scroll_offset = 0;
+		// extent laid out before and after the window
+		Px overscan = 0;
+
+		ProvideItem provide_item;
+		RecycleItem recycle_item;
+
+		VirtualListLayoutMode(
+			Px estimated_extent,
+			Axis axis = Axis::Vertical
+		) noexcept
+			: axis{axis}, estimated_extent{estimated_extent}
+		{}
+
+		void ComputeLayout(
+			Element& el,
+			const PxRect& content_rect
+		) noexcept override;
+
+		size_t GetItemCount() const noexcept {
+			return extents.size();
+		}
+
+		/// @brief Adds or removes rows at the end of the list
+		void SetItemCount(size_t count);
+
+		/// @brief Sets the extent of a row, such as one known before it
+		/// is materialized
+		void SetItemExtent(size_t index, Px extent) noexcept {
+			extents.set(index, extent);
+		}
+
+		const ExtentTree& GetExtents() const noexcept {
+			return extents;
+		}
+
+		/// @brief Extent of all rows, for sizing a scroll bar
+		Px GetContentExtent() const noexcept {
+			return extents.total();
+		}
+
+		/// @brief First row of the last layout's window
+		size_t GetFirstIndex() const noexcept {
+			return first_index;
+		}
+
+		/// @brief One past the last row of the last layout's window
+		size_t GetEndIndex() const noexcept {
+			return end_index;
+		}
+
+	private:
+		ExtentTree extents;
+		size_t first_index = 0;
+		size_t end_index = 0;
+		// children of the next window, swapped with the element's children
+		std::vector<std::shared_ptr<Element>> next_children;
+
+		/// @brief Replaces the children of el with the rows [first, end)
+		void Materialize(Element& el, size_t first, size_t end);
+	};
+}
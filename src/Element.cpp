@@ -1,59 +1,343 @@
 #include <klay/Element.hpp>
 #include <klay/Flex.hpp>
+#include <klay/Stats.hpp>
+#include <klay/ThreadPool.hpp>
 
-#include <iostream>
+bool Klay::Element::IsLayoutCached(const Klay::PxRect& rect) noexcept {
+	CountLayoutStat(LayoutCounter::ElementsVisited);
+
+	// dirty_layout is only cleared once the whole subtree is laid out,
+	// and every ancestor of a dirty element is dirty (see MarkDirty),
+	// so a clean element laid out with the same inputs has a clean subtree
+	if(!dirty_layout && layout_cache.Matches(rect)) {
+		CountLayoutStat(LayoutCounter::LayoutCacheHits);
+		return true;
+	}
+	CountLayoutStat(LayoutCounter::LayoutCacheMisses);
+	return false;
+}
 
 void Klay::Element::ComputeLayout(const Klay::PxRect& parentRect) noexcept {
+	LayoutTraceScope trace{LayoutTraceCallKind::Layout, *this, parentRect};
+	LayoutPhaseTimer timer{LayoutPhase::Layout};
+
+	// fields may have been changed without MarkDirty, so this always
+	// lays out. Only the tree passes skip clean elements.
+	ComputeLayoutUncached(parentRect);
+	// only the children were laid out, not the whole subtree
+	MarkLayoutDirty();
+}
+
+void Klay::Element::ComputeLayoutUncached(const Klay::PxRect& parentRect) noexcept {
+	layout_cache = LayoutCache{parentRect, true};
 	if(!layout_mode) return;
 
-	auto content_rect = parentRect + layout_options.padding.Transform(
-		[&](const EdgeLength<Unit>& edgeLength, Axis axis) -> EdgeLength<Px> {
-			return edgeLength.Transform([&](const Unit& unit, Edge edge) -> Px {
-				return unit.CalculatePx(parentRect, axis);
-			});
-		}
-	);
+	// percent padding resolves against the content box of the parent,
+	// as in the min size, and against its own rect without a parent
+	const auto padding_basis = layout_sizes_valid
+		? layout_size_basis
+		: PxSize{parentRect.Width(), parentRect.Height()};
+	auto content_rect = ComputeContentRect(layout_options, parentRect, padding_basis);
+	const PxSize content_size { content_rect.Width(), content_rect.Height() };
+	bool limited = false;
 	for(auto& child : children) {
 		if(child->dirty_size) {
 			child->ComputeMinSize();
 		}
+		child->ResolveLayoutSizes(content_size);
+		limited |= child->has_size_limits;
+	}
+	limited_children = limited;
+	CountLayoutStat(LayoutCounter::LayoutModeCalls);
+	layout_mode.ComputeLayout(*this, content_rect);
+}
+
+void Klay::Element::ComputeTreeLayout(const Klay::PxRect& rect) noexcept {
+	LayoutTraceScope trace{LayoutTraceCallKind::TreeLayout, *this, rect};
+	ComputeMinSize();
+
+	LayoutPhaseTimer timer{LayoutPhase::Layout};
+	ComputeSubtreeLayout(rect);
+}
+
+void Klay::Element::ComputeTreeLayout(
+	const Klay::PxRect& rect,
+	Klay::DamageList& damage
+) noexcept {
+	LayoutTraceScope trace{LayoutTraceCallKind::DamageTreeLayout, *this, rect};
+	damage.Clear();
+	ComputeMinSize();
+
+	LayoutPhaseTimer timer{LayoutPhase::Layout};
+	ComputeSubtreeLayout(rect, &damage);
+}
+
+void Klay::Element::ComputeSubtreeLayout(
+	const Klay::PxRect& rect,
+	Klay::DamageList* damage
+) noexcept {
+	// the layout cache holds the rect of the last layout, so this
+	// also covers elements that moved without a layout mode
+	if(damage && !(layout_cache.valid && layout_cache.rect == rect)) {
+		damage->Add(
+			*this,
+			layout_cache.valid ? std::optional{layout_cache.rect} : std::nullopt,
+			rect
+		);
+	}
+
+	if(IsLayoutCached(rect)) {
+		return;
+	}
+	ComputeLayoutUncached(rect);
+	for(auto& child : children) {
+		child->ComputeSubtreeLayout(child->ComputedRect(), damage);
+	}
+	ComputeSubtreeBounds(rect);
+	dirty_layout = false;
+}
+
+void Klay::Element::ComputeSubtreeBounds(const Klay::PxRect& rect) noexcept {
+	subtree_bounds = rect;
+	for(const auto& child : children) {
+		subtree_bounds = subtree_bounds.Union(child->subtree_bounds);
+	}
+}
+
+std::shared_ptr<Klay::Element> Klay::Element::QueryPoint(
+	const Klay::PxPoint& point
+) noexcept {
+	if(!subtree_bounds.Contains(point)) {
+		return nullptr;
+	}
+	for(auto child = children.rbegin(); child != children.rend(); ++child) {
+		if(auto hit = (*child)->QueryPoint(point)) {
+			return hit;
+		}
+	}
+	// the layout cache holds the rect this element was laid out with
+	if(layout_cache.valid && layout_cache.rect.Contains(point)) {
+		return shared_from_this();
+	}
+	return nullptr;
+}
+
+void Klay::Element::QueryRect(
+	const Klay::PxRect& rect,
+	std::vector<std::shared_ptr<Element>>& hits
+) {
+	if(!subtree_bounds.Intersects(rect)) {
+		return;
+	}
+	if(layout_cache.valid && layout_cache.rect.Intersects(rect)) {
+		hits.push_back(shared_from_this());
+	}
+	for(auto& child : children) {
+		child->QueryRect(rect, hits);
+	}
+}
+
+void Klay::Element::ComputeTreeLayout(
+	const Klay::PxRect& rect,
+	Klay::ThreadPool& pool,
+	size_t min_parallel_size
+) noexcept {
+	LayoutTraceScope trace{LayoutTraceCallKind::ParallelTreeLayout, *this, rect, min_parallel_size};
+	ComputeMinSize();
+
+	LayoutPhaseTimer timer{LayoutPhase::Layout};
+	ComputeSubtreeLayout(rect, pool, min_parallel_size);
+}
+
+void Klay::Element::ComputeSubtreeLayout(
+	const Klay::PxRect& rect,
+	Klay::ThreadPool& pool,
+	size_t min_parallel_size
+) noexcept {
+	if(subtree_size < min_parallel_size) {
+		ComputeSubtreeLayout(rect);
+		return;
+	}
+
+	if(IsLayoutCached(rect)) {
+		return;
+	}
+	ComputeLayoutUncached(rect);
+
+	// sibling subtrees only read their own rect, which is assigned above
+	ThreadPool::TaskGroup group;
+	for(auto& child : children) {
+		if(child->subtree_size >= min_parallel_size) {
+			Element* large_child = child.get();
+			pool.Spawn(group, [large_child, &pool, min_parallel_size] {
+				large_child->ComputeSubtreeLayout(
+					large_child->ComputedRect(),
+					pool,
+					min_parallel_size
+				);
+			});
+		}
+	}
+	for(auto& child : children) {
+		if(child->subtree_size < min_parallel_size) {
+			child->ComputeSubtreeLayout(child->ComputedRect());
+		}
 	}
-	layout_mode->ComputeLayout(shared_from_this(), content_rect);
+	pool.Wait(group);
+
+	ComputeSubtreeBounds(rect);
 	dirty_layout = false;
 }
 
+void Klay::Element::MarkDirty() noexcept {
+	if(IsLayoutTraceRecording()) {
+		Detail::TraceMarkDirty(*this);
+	}
+	dirty_size = true;
+	dirty_layout = true;
+	measure_cache.Clear();
+
+	// ComputeMinSize turns dirty_size into dirty_layout, so only the
+	// dirty size needs to reach the root. If an ancestor is already dirty,
+	// so are all of its ancestors.
+	auto ancestor = parent.lock();
+	while(ancestor && !ancestor->dirty_size) {
+		ancestor->dirty_size = true;
+		ancestor->dirty_layout = true;
+		ancestor = ancestor->parent.lock();
+	}
+}
+
+void Klay::Element::MarkLayoutDirty() noexcept {
+	dirty_layout = true;
+
+	auto ancestor = parent.lock();
+	while(ancestor && !ancestor->dirty_layout) {
+		ancestor->dirty_layout = true;
+		ancestor = ancestor->parent.lock();
+	}
+}
+
 void Klay::Element::ComputeMinSize() noexcept {
 	if(!dirty_size) {
 		return;
 	}
+	LayoutPhaseTimer timer{LayoutPhase::MinSize};
+	CountLayoutStat(LayoutCounter::MinSizeComputes);
+
 	dirty_layout = true;
 	dirty_size = false;
+	layout_sizes_valid = false;
 
-	PxSize computed {0, 0};
+	PxSize content {0, 0};
+	subtree_size = 1;
 	for(auto& child : children) {
 		if(child->dirty_size) {
 			child->ComputeMinSize();
 		}
-		computed += child->computed_min_size;
+		content += child->computed_min_size;
+		subtree_size += child->subtree_size;
 	}
 
-	computed += layout_options.padding.Transform(
-		[&](const EdgeLength<Unit>& edgeLength, Axis axis) -> Px {
-			return edgeLength.Start().TryGet<Px>().value_or(Px{0})
-				+ edgeLength.End().TryGet<Px>().value_or(Px{0});
+	if(measure) {
+		const auto measured = Measure(0, MeasureMode::Undefined);
+		for(int i = 0; i < 2; ++i) {
+			content.axes[i] = std::max(content.axes[i], measured.axes[i]);
 		}
-	);
+	}
+
+	computed_min_size = MinSizeForContent(content, PxSize{0, 0});
+
+	// read here, next to size.min, so the layout pass only touches size
+	// for elements that need it
+	const auto is_percent = [](const std::optional<Unit>& unit) {
+		return unit && unit->Is<Percent>();
+	};
+	has_percent_min_size = is_percent(size.min.axes[0]) || is_percent(size.min.axes[1]);
+	has_percent_padding = SumPadding(layout_options.padding).HasPercent();
+	has_size_limits = size.value.axes[0] || size.value.axes[1]
+		|| size.max.axes[0] || size.max.axes[1];
+	if(!has_size_limits) {
+		computed_preferred_size = OptionalPxSize{};
+		computed_max_size = unbounded_size;
+	}
+}
+
+void Klay::Element::ResolveSizeRange(const Klay::PxSize& basis) noexcept {
+	for(int i = 0; i < 2; ++i) {
+		const Px axis_basis = basis.axes[i];
+		if(const auto& min = size.min.axes[i]; min && min->Is<Percent>()) {
+			layout_min_size.axes[i] = std::max(layout_min_size.axes[i], min->Resolve(axis_basis));
+		}
+		const auto& value = size.value.axes[i];
+		computed_preferred_size.axes[i] = value
+			? std::optional{value->Resolve(axis_basis)}
+			: std::nullopt;
+		const auto& max = size.max.axes[i];
+		computed_max_size.axes[i] = max ? max->Resolve(axis_basis) : unbounded_size.axes[i];
+	}
+}
 
+Klay::PxSize Klay::Element::MinSizeForContent(
+	Klay::PxSize content,
+	const Klay::PxSize& basis
+) const noexcept {
+	PxSize computed = content;
+	computed += SumPadding(layout_options.padding).Resolve(basis);
+
+	// percentages are resolved in the layout pass, see ResolveLayoutSizes
 	for(int i = 0; i < 2; ++i){
 		auto minSize = size.min.axes[i].value_or(Px{0});
 		if(minSize.Is<Px>()) {
 			computed.axes[i] = std::max(computed.axes[i], minSize.Get<Px>());
 		}
 	}
+	return computed;
+}
+
+Klay::PxSize Klay::Element::MeasureLayoutMinSize(const Klay::PxSize& basis) noexcept {
+	const auto padding = SumPadding(layout_options.padding).Resolve(basis);
+	const auto measured = Measure(
+		std::max(basis.Horizontal() - padding.Horizontal(), 0.0f),
+		MeasureMode::AtMost
+	);
+
+	PxSize content = ChildrenMinSize();
+	for(int i = 0; i < 2; ++i) {
+		content.axes[i] = std::max(content.axes[i], measured.axes[i]);
+	}
+	return MinSizeForContent(content, basis);
+}
+
+Klay::PxSize Klay::Element::ChildrenMinSize() const noexcept {
+	PxSize content {0, 0};
+	for(const auto& child : children) {
+		content += child->computed_min_size;
+	}
+	return content;
+}
+
+Klay::PxSize Klay::Element::Measure(
+	Klay::Px available_width,
+	Klay::MeasureMode mode
+) noexcept {
+	if(!measure) {
+		return PxSize{0, 0};
+	}
+	if(mode == MeasureMode::Undefined) {
+		available_width = 0;
+	}
+
+	if(const auto cached = measure_cache.Find(available_width, mode)) {
+		return *cached;
+	}
 
-	computed_min_size = computed;
+	CountLayoutStat(LayoutCounter::MeasureCalls);
+	const auto measured = measure(*this, available_width, mode);
+	measure_cache.Insert(available_width, mode, measured);
+	return measured;
 }
 
 void Klay::Element::AssignDefaultLayoutMode() noexcept {
-	layout_mode = std::make_unique<FlexLayoutMode>();
+	layout_mode = FlexLayoutMode{};
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include <klay/ElementTreeBuilder.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+// Block that elements are allocated from. Allocations past the end
+// of the block, which only happen if the node size was underestimated,
+// fall back to the global allocator.
+struct Klay::ElementArena {
+	std::unique_ptr<std::byte[]> data;
+	size_t capacity;
+	size_t used = 0;
+	// bytes asked for so far, including those that did not fit
+	size_t requested = 0;
+
+	explicit ElementArena(size_t capacity)
+		: data{std::make_unique_for_overwrite<std::byte[]>(capacity)}
+		, capacity{capacity}
+	{}
+
+	size_t Available() const noexcept {
+		return capacity - used;
+	}
+
+	void* Allocate(size_t bytes, size_t alignment) {
+		requested += bytes;
+		const auto base = reinterpret_cast<std::uintptr_t>(data.get());
+		const size_t start = ((base + used + alignment - 1) & ~(alignment - 1)) - base;
+		if (start + bytes > capacity) {
+			return ::operator new(bytes);
+		}
+		used = start + bytes;
+		return data.get() + start;
+	}
+
+	void Deallocate(void* p) noexcept {
+		// memory in the block is freed with the block
+		const auto* byte = static_cast<const std::byte*>(p);
+		if (byte < data.get() || byte >= data.get() + capacity) {
+			::operator delete(p);
+		}
+	}
+};
+
+namespace {
+	using namespace Klay;
+
+	// smallest block allocated when nothing is reserved
+	constexpr size_t min_arena_nodes = 64;
+
+	// Each element keeps a copy in its control block,
+	// so the arena lives as long as any of its elements
+	template<typename T>
+	struct ArenaAllocator {
+		using value_type = T;
+
+		std::shared_ptr<ElementArena> arena;
+
+		explicit ArenaAllocator(std::shared_ptr<ElementArena> arena) noexcept
+			: arena{std::move(arena)}
+		{}
+
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+			: arena{other.arena}
+		{}
+
+		T* allocate(size_t n) {
+			return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* p, size_t) noexcept {
+			arena->Deallocate(p);
+		}
+
+		template<typename U>
+		bool operator==(const ArenaAllocator<U>& other) const noexcept {
+			return arena == other.arena;
+		}
+	};
+
+	// bytes allocate_shared takes for one element, control block included,
+	// rounded up so that consecutive nodes stay aligned
+	size_t ElementNodeSize() {
+		static const size_t size = [] {
+			const auto arena = std::make_shared<ElementArena>(0);
+			std::allocate_shared<Element>(ArenaAllocator<Element>{arena});
+			constexpr size_t alignment = alignof(std::max_align_t);
+			return (arena->requested + alignment - 1) / alignment * alignment;
+		}();
+		return size;
+	}
+}
+
+void Klay::ElementTreeBuilder::Reserve(size_t count) {
+	reserved = std::max(reserved, count);
+	elements.reserve(count);
+	parents.reserve(count);
+	num_children.reserve(count);
+}
+
+size_t Klay::ElementTreeBuilder::Add(ElementBuilder& builder, size_t parent) {
+	assert((parent == null_handle) == elements.empty() && "only the first element is a root");
+	assert((parent == null_handle || parent < elements.size()) && "parents must be added first");
+
+	const size_t node_size = ElementNodeSize();
+	if (!arena || arena->Available() < node_size) {
+		// the rest of the reservation, or as many elements as so far
+		const size_t nodes = std::max({
+			reserved > elements.size() ? reserved - elements.size() : 0,
+			elements.size(),
+			min_arena_nodes,
+		});
+		arena = std::make_shared<ElementArena>(nodes * node_size);
+	}
+
+	const size_t handle = elements.size();
+	elements.push_back(std::allocate_shared<Element>(
+		ArenaAllocator<Element>{arena},
+		std::move(builder.element)
+	));
+	parents.push_back(parent);
+	num_children.push_back(0);
+	if (parent != null_handle) {
+		++num_children[parent];
+	}
+	return handle;
+}
+
+std::shared_ptr<Klay::Element> Klay::ElementTreeBuilder::Build() {
+	if (elements.empty()) {
+		return nullptr;
+	}
+
+	for (size_t i = 0; i < elements.size(); ++i) {
+		elements[i]->children.reserve(num_children[i]);
+	}
+	// children are added in handle order, like AddChild would
+	for (size_t i = 1; i < elements.size(); ++i) {
+		const auto& parent = elements[parents[i]];
+		if (IsLayoutTraceRecording()) {
+			Detail::TraceAddChild(*parent, *elements[i]);
+		}
+		elements[i]->Reparent(parent);
+		parent->children.push_back(elements[i]);
+	}
+
+	auto root = elements.front();
+	arena.reset();
+	reserved = 0;
+	elements.clear();
+	parents.clear();
+	num_children.clear();
+	return root;
+}
@@ -1,120 +1,392 @@
 #include <klay/Flex.hpp>
 #include <klay/Element.hpp>
+#include <klay/LayoutTree.hpp>
+#include <klay/Stats.hpp>
 
-void Klay::FlexLayoutMode::ComputeLayout(
-	std::shared_ptr<Element> el,
-	const Klay::PxRect& contentRect
-) noexcept {
-	const auto& layout_options = el->layout_options;
-	const auto& children = el->children;
-
-	Axis cross_axis = CrossAxis(main_axis);
-	Px main_axis_size;
-	float total_grow = 0;
-
-	// calculate total flex grow
-	// and minimum size along the main axis
-	for(const auto& child : children) {
-		main_axis_size += child->computed_min_size.GetAxis(main_axis);
-		total_grow += child->item_options.grow;
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+	using namespace Klay;
+
+	// Accessors for the items of a flex container.
+	// The layout algorithm is written against these so that it runs
+	// over both Element children and LayoutTree nodes.
+	// Unless limited, the items have no preferred or max sizes and are
+	// laid out from their min sizes, see Element::limited_children.
+	template<bool limited>
+	struct ElementFlexItems {
+		const std::vector<std::shared_ptr<Element>>& children;
+
+		size_t Size() const noexcept {
+			return children.size();
+		}
+
+		PxSize MinSize(size_t i) const noexcept {
+			return children[i]->layout_min_size;
+		}
+
+		PxSize PreferredSize(size_t i) const noexcept {
+			const auto& child = *children[i];
+			if constexpr(!limited) {
+				return child.layout_min_size;
+			}
+			return ClampSize(child.computed_preferred_size, child.layout_min_size, child.computed_max_size);
+		}
+
+		PxSize MaxSize(size_t i) const noexcept {
+			const auto& child = *children[i];
+			if constexpr(!limited) {
+				return unbounded_size;
+			}
+			return ClampSize(child.computed_max_size, child.layout_min_size, child.computed_max_size);
+		}
+
+		float Grow(size_t i) const noexcept {
+			return children[i]->item_options.grow;
+		}
+
+		float Shrink(size_t i) const noexcept {
+			return children[i]->item_options.shrink;
+		}
+
+		std::optional<Align> AlignSelf(size_t i) const noexcept {
+			return children[i]->item_options.align_self;
+		}
+
+		PxSize& ComputedSize(size_t i) const noexcept {
+			return children[i]->computed_size;
+		}
+
+		PxPoint& ComputedPosition(size_t i) const noexcept {
+			return children[i]->computed_position;
+		}
+	};
+
+	template<bool limited>
+	struct TreeFlexItems {
+		LayoutTree& tree;
+		NodeHandle first;
+		size_t count;
+
+		size_t Size() const noexcept {
+			return count;
+		}
+
+		PxSize MinSize(size_t i) const noexcept {
+			return tree.computed_min_size[first + i];
+		}
+
+		PxSize PreferredSize(size_t i) const noexcept {
+			const auto node = first + i;
+			if constexpr(!limited) {
+				return tree.computed_min_size[node];
+			}
+			return ClampSize(tree.preferred_size[node], tree.computed_min_size[node], tree.max_size[node]);
+		}
+
+		PxSize MaxSize(size_t i) const noexcept {
+			const auto node = first + i;
+			if constexpr(!limited) {
+				return unbounded_size;
+			}
+			return ClampSize(tree.max_size[node], tree.computed_min_size[node], tree.max_size[node]);
+		}
+
+		float Grow(size_t i) const noexcept {
+			return tree.grow[first + i];
+		}
+
+		float Shrink(size_t i) const noexcept {
+			return tree.shrink[first + i];
+		}
+
+		std::optional<Align> AlignSelf(size_t i) const noexcept {
+			return tree.align_self[first + i];
+		}
+
+		PxSize& ComputedSize(size_t i) const noexcept {
+			return tree.computed_size[first + i];
+		}
+
+		PxPoint& ComputedPosition(size_t i) const noexcept {
+			return tree.computed_position[first + i];
+		}
+	};
+
+	// Lays out a single line of items without size limits with the flex
+	// kernels, gathering them into the scratch arrays and scattering the
+	// results back. Returns false, leaving them to ComputeFlexLine, if an
+	// item shrinks, which the kernels do not handle.
+	// The caller checks the other conditions, see flex_kernel_min_items.
+	template<typename Items>
+	bool ComputeFlexLineKernel(
+		Axis main_axis,
+		const LayoutOptions& layout_options,
+		const PxRect& contentRect,
+		const Items& items
+	) noexcept {
+		const Axis cross_axis = CrossAxis(main_axis);
+		const size_t count = items.Size();
+		for(size_t i = 0; i < count; ++i) {
+			if(items.Shrink(i) > 0) {
+				return false;
+			}
+		}
+
+		auto& scratch = GetFlexLineScratch();
+		CountLayoutStat(LayoutCounter::ScratchGrowths, scratch.Resize(count));
+		for(size_t i = 0; i < count; ++i) {
+			const auto min_size = items.MinSize(i);
+			scratch.min_main[i] = min_size.GetAxis(main_axis).value;
+			scratch.min_cross[i] = min_size.GetAxis(cross_axis).value;
+			scratch.grow[i] = items.Grow(i);
+			scratch.align[i] = static_cast<std::uint32_t>(
+				items.AlignSelf(i).value_or(layout_options.align_items)
+			);
+		}
+
+		const auto params = ResolveFlexLineParams(
+			main_axis,
+			layout_options,
+			contentRect,
+			count,
+			SumFlexLine(scratch, count)
+		);
+		ComputeFlexLineItems(scratch, count, params);
+
+		for(size_t i = 0; i < count; ++i) {
+			auto& computed_size = items.ComputedSize(i);
+			auto& computed_position = items.ComputedPosition(i);
+			computed_size.GetAxis(main_axis) = scratch.main_size[i];
+			computed_size.GetAxis(cross_axis) = scratch.cross_size[i];
+			computed_position.GetAxis(main_axis) = scratch.main_position[i];
+			computed_position.GetAxis(cross_axis) = scratch.cross_position[i];
+		}
+		return true;
 	}
 
-	Px main_axis_gap = layout_options.main_gap.CalculatePx(
-		contentRect,
-		main_axis
-	);
+	// Items [first, first + count) of another accessor,
+	// used to lay out a single line of a wrapped container
+	template<typename Items>
+	struct ItemRange {
+		const Items& items;
+		size_t first;
+		size_t count;
 
-	Px extra_space = contentRect.GetAxis(main_axis).length
-		- main_axis_size
-		- main_axis_gap * (el->NumChildren() - 1);
+		size_t Size() const noexcept {
+			return count;
+		}
 
-	Px remaining_space = extra_space;
+		PxSize MinSize(size_t i) const noexcept {
+			return items.MinSize(first + i);
+		}
 
-	// apply flex grow and, if align items or align self is stretch,
-	// stretch item across cross axis
-	for(const auto& child : children) {
-		const auto& item_options = child->item_options;
+		PxSize PreferredSize(size_t i) const noexcept {
+			return items.PreferredSize(first + i);
+		}
 
-		float length_px = child->computed_min_size.GetAxis(main_axis).value;
-		float grow = item_options.grow;
-		if(grow > 0){
-			float grow_px = extra_space.value * grow / total_grow;
-			length_px += grow_px;
-			remaining_space -= grow_px;
+		PxSize MaxSize(size_t i) const noexcept {
+			return items.MaxSize(first + i);
 		}
-		child->computed_size.GetAxis(main_axis) = length_px;
 
-		auto align = item_options.align_self.value_or(layout_options.align_items);
-		if(align == Align::Stretch){
-			child->computed_size.GetAxis(cross_axis) = contentRect.GetAxis(cross_axis).length;
+		float Grow(size_t i) const noexcept {
+			return items.Grow(first + i);
 		}
-		// no stretch
-		else {
-			child->computed_size.GetAxis(cross_axis) = child->computed_min_size.GetAxis(cross_axis);
+
+		float Shrink(size_t i) const noexcept {
+			return items.Shrink(first + i);
+		}
+
+		std::optional<Align> AlignSelf(size_t i) const noexcept {
+			return items.AlignSelf(first + i);
+		}
+
+		PxSize& ComputedSize(size_t i) const noexcept {
+			return items.ComputedSize(first + i);
+		}
+
+		PxPoint& ComputedPosition(size_t i) const noexcept {
+			return items.ComputedPosition(first + i);
 		}
+	};
+}
+
+std::vector<Klay::FlexFreezeItem>& Klay::GetFlexFreezeScratch() noexcept {
+	thread_local std::vector<FlexFreezeItem> scratch;
+	return scratch;
+}
+
+template<typename Items>
+void Klay::FlexLayoutMode::ComputeWrappedLayout(
+	const LayoutOptions& layout_options,
+	const Klay::PxRect& contentRect,
+	const Items& items,
+	size_t first_dirty
+) noexcept {
+	const auto num_items = items.Size();
+	const Axis cross_axis = CrossAxis(main_axis);
+	const Px main_axis_length = contentRect.GetAxis(main_axis).length;
+
+	const auto gaps = ResolveGaps(layout_options, contentRect, main_axis);
+	const LineCacheKey key {
+		contentRect,
+		gaps.main,
+		gaps.cross,
+		layout_options.justify_content,
+		layout_options.align_items,
+	};
+
+	if(!line_cache) {
+		line_cache = std::make_unique<LineCache>();
 	}
+	auto& lines = line_cache->lines;
 
-	Px main_axis_offset;
-	// justify content doesn't make sense if there is no extra space
-	if(total_grow == 0){
-		switch(layout_options.justify_content) {
-			case Justify::End:
-				main_axis_offset = remaining_space;
-				break;
-			case Justify::Center:
-				main_axis_offset = remaining_space / 2;
-				break;
-			case Justify::SpaceAround: {
-				// split remaining space between the leftOffset, gap, and rightOffset
-				Px split = remaining_space / el->NumChildren();
-				main_axis_offset = split / 2;
-				main_axis_gap += split;
-				break;
+	// a line is kept if the item after it is unchanged,
+	// since that item is what ended the line
+	size_t first_line = 0;
+	if(line_cache->valid && key == line_cache->key) {
+		first_dirty = std::min({first_dirty, line_cache->num_items, num_items});
+		while(first_line < lines.size() && lines[first_line].End() < first_dirty) {
+			++first_line;
+		}
+	}
+	lines.resize(first_line);
+	const auto lines_capacity = lines.capacity();
+
+	FlexLine line;
+	if(!lines.empty()) {
+		line.start = lines.back().End();
+		line.cross_offset = lines.back().cross_offset
+			+ lines.back().cross_size
+			+ key.cross_gap;
+	}
+
+	// break lines in a single pass over the preferred sizes
+	Px line_length;
+	for(size_t i = line.start; i < num_items; ++i) {
+		const auto base_size = items.PreferredSize(i);
+		const Px item_length = base_size.GetAxis(main_axis);
+
+		// an item starting a line never breaks, even if it overflows
+		if(line.count > 0) {
+			if(line_length + key.main_gap + item_length > main_axis_length) {
+				lines.push_back(line);
+				line = FlexLine{
+					i,
+					0,
+					line.cross_offset + line.cross_size + key.cross_gap,
+					0,
+				};
+				line_length = item_length;
 			}
-			case Justify::SpaceEvenly: {
-				Px split = remaining_space / (el->NumChildren() + 1);
-				main_axis_offset = split;
-				main_axis_gap += split;
-				break;
+			else {
+				line_length += key.main_gap + item_length;
 			}
-			case Justify::SpaceBetween:
-				main_axis_gap += remaining_space / (el->NumChildren() - 1);
-				break;
 		}
-	}
+		else {
+			line_length = item_length;
+		}
 
-	// compute position
-	for(auto& child : children) {
-		const auto& item_options = child->item_options;
+		++line.count;
+		line.cross_size = std::max(line.cross_size, base_size.GetAxis(cross_axis));
+	}
+	if(line.count > 0) {
+		lines.push_back(line);
+	}
+	CountLayoutStat(LayoutCounter::ScratchGrowths, lines.capacity() != lines_capacity);
 
-		child->computed_position.GetAxis(main_axis) = (
-			contentRect.GetAxis(main_axis).start + main_axis_offset
+	// each line is laid out as a single line flex container
+	// as wide as the content box and as tall as its tallest item
+	for(size_t i = first_line; i < lines.size(); ++i) {
+		const auto& line = lines[i];
+		PxRect line_rect = contentRect;
+		line_rect.GetAxis(cross_axis) = Segment<Px>{
+			contentRect.GetAxis(cross_axis).start + line.cross_offset,
+			line.cross_size,
+		};
+		ComputeFlexLine(
+			main_axis,
+			layout_options,
+			line_rect,
+			ItemRange<Items>{items, line.start, line.count}
 		);
-		main_axis_offset += child->computed_size.GetAxis(main_axis) + main_axis_gap;
+	}
 
-		auto cross_axis_extra_space = (
-			contentRect.GetAxis(cross_axis).length
-			- child->computed_size.GetAxis(cross_axis)
-		);
-		auto align = item_options.align_self.value_or(
-			layout_options.align_items
-		);
+	line_cache->key = key;
+	line_cache->num_items = num_items;
+	line_cache->valid = true;
+}
 
-		Px cross_axis_offset;
-		switch(align) {
-			case Align::Start:
-			case Align::Stretch:
-				cross_axis_offset = 0;
-				break;
-			case Align::End:
-				cross_axis_offset = cross_axis_extra_space;
-				break;
-			case Align::Center:
-				cross_axis_offset = cross_axis_extra_space / 2;
-				break;
-		}
-		child->computed_position.GetAxis(cross_axis) = (
-			contentRect.GetAxis(cross_axis).start + cross_axis_offset
-		);
+void Klay::FlexLayoutMode::ComputeLayout(
+	Element& el,
+	const Klay::PxRect& contentRect
+) noexcept {
+	CountLayoutStat(LayoutCounter::FlexLayoutCalls);
+
+	const auto layout = [&](const auto& items) {
+		if(wrap == FlexWrap::NoWrap) {
+			ComputeFlexLine(main_axis, el.layout_options, contentRect, items);
+			return;
+		}
+
+		// the inputs of an item only change when it is marked dirty, and it
+		// stays dirty until it is laid out, so items before the first dirty
+		// child keep their rects, unless the child list changed under them
+		const auto& children = el.children;
+		const size_t num_cached = line_cache ? line_cache->children.size() : 0;
+		size_t first_dirty = 0;
+		while(first_dirty < std::min(children.size(), num_cached)
+			&& !children[first_dirty]->dirty_layout
+			&& line_cache->children[first_dirty] == children[first_dirty].get()) {
+			++first_dirty;
+		}
+		ComputeWrappedLayout(el.layout_options, contentRect, items, first_dirty);
+
+		auto& cached = line_cache->children;
+		const auto cached_capacity = cached.capacity();
+		cached.resize(children.size());
+		CountLayoutStat(LayoutCounter::ScratchGrowths, cached.capacity() != cached_capacity);
+		for(size_t i = first_dirty; i < children.size(); ++i) {
+			cached[i] = children[i].get();
+		}
+	};
+	// children without size limits are laid out without clamping,
+	// and wide rows of them run the vectorized kernels
+	if(el.limited_children) {
+		layout(ElementFlexItems<true>{el.children});
+	}
+	else if(wrap != FlexWrap::NoWrap
+		|| el.children.size() < flex_kernel_min_items
+		|| !ComputeFlexLineKernel(main_axis, el.layout_options, contentRect, ElementFlexItems<false>{el.children})) {
+		layout(ElementFlexItems<false>{el.children});
+	}
+}
+
+void Klay::FlexLayoutMode::ComputeLayout(
+	LayoutTree& tree,
+	NodeHandle node,
+	const Klay::PxRect& contentRect
+) noexcept {
+	CountLayoutStat(LayoutCounter::FlexLayoutCalls);
+
+	const auto layout = [&](const auto& items) {
+		if(wrap == FlexWrap::NoWrap) {
+			ComputeFlexLine(main_axis, tree.GetLayoutOptions(node), contentRect, items);
+			return;
+		}
+		// tree nodes have no dirty flags
+		ComputeWrappedLayout(tree.GetLayoutOptions(node), contentRect, items, 0);
+	};
+	// children without size limits are laid out without clamping,
+	// and wide rows of them run the vectorized kernels
+	const TreeFlexItems<false> unlimited_items {tree, tree.first_child[node], tree.num_children[node]};
+	if(tree.limited_children[node]) {
+		layout(TreeFlexItems<true>{tree, tree.first_child[node], tree.num_children[node]});
+	}
+	else if(wrap != FlexWrap::NoWrap
+		|| unlimited_items.Size() < flex_kernel_min_items
+		|| !ComputeFlexLineKernel(main_axis, tree.GetLayoutOptions(node), contentRect, unlimited_items)) {
+		layout(unlimited_items);
 	}
-}
\ No newline at end of file
+}
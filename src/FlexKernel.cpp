@@ -0,0 +1,436 @@
+#include <klay/FlexKernel.hpp>
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define KLAY_FLEX_KERNEL_X86 1
+	#include <immintrin.h>
+	#if defined(__GNUC__)
+		#define KLAY_TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+		#define KLAY_TARGET_AVX2
+	#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define KLAY_FLEX_KERNEL_NEON 1
+	#include <arm_neon.h>
+#endif
+
+namespace {
+	using namespace Klay;
+
+	// Scalar tails of the kernels, and the whole of the scalar kernels.
+	// Each lane of the vector loops computes exactly these operations.
+
+	void AddToLanes(
+		float (&lanes)[flex_kernel_lanes],
+		const float* values,
+		size_t first,
+		size_t count
+	) noexcept {
+		for (size_t i = first; i < count; ++i) {
+			lanes[i % flex_kernel_lanes] += values[i];
+		}
+	}
+
+	void ComputeItemsScalar(
+		FlexLineScratch& scratch,
+		size_t first,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept {
+		for (size_t i = first; i < count; ++i) {
+			const auto align = static_cast<Align>(scratch.align[i]);
+			const float main_length = FlexGrownLength(scratch.min_main[i], scratch.grow[i], params);
+			const float cross_length = FlexCrossLength(scratch.min_cross[i], align, params);
+			scratch.main_size[i] = main_length;
+			scratch.cross_size[i] = cross_length;
+			scratch.cross_position[i] = FlexCrossPosition(cross_length, align, params);
+			// the step to the next item, turned into a position by the scan
+			scratch.main_position[i] = main_length + params.gap;
+		}
+	}
+
+	// Positions depend on every item before them. Adding the steps in a
+	// different order would round differently, so this stays sequential.
+	void ScanMainPositions(
+		FlexLineScratch& scratch,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept {
+		float offset = params.main_offset;
+		for (size_t i = 0; i < count; ++i) {
+			const float step = scratch.main_position[i];
+			scratch.main_position[i] = params.main_start + offset;
+			offset += step;
+		}
+	}
+
+	FlexLineSums SumScalar(const FlexLineScratch& scratch, size_t count) noexcept {
+		float min_main[flex_kernel_lanes] {};
+		float grow[flex_kernel_lanes] {};
+		AddToLanes(min_main, scratch.min_main.data(), 0, count);
+		AddToLanes(grow, scratch.grow.data(), 0, count);
+		return FlexLineSums{FoldFlexLanes(min_main), FoldFlexLanes(grow)};
+	}
+
+#if KLAY_FLEX_KERNEL_X86
+	// 8 lanes as two registers of 4
+	FlexLineSums SumSSE2(const FlexLineScratch& scratch, size_t count) noexcept {
+		const float* min_main = scratch.min_main.data();
+		const float* grow = scratch.grow.data();
+		__m128 min_lo = _mm_setzero_ps();
+		__m128 min_hi = _mm_setzero_ps();
+		__m128 grow_lo = _mm_setzero_ps();
+		__m128 grow_hi = _mm_setzero_ps();
+
+		const size_t blocks = count / flex_kernel_lanes * flex_kernel_lanes;
+		for (size_t i = 0; i < blocks; i += flex_kernel_lanes) {
+			min_lo = _mm_add_ps(min_lo, _mm_loadu_ps(min_main + i));
+			min_hi = _mm_add_ps(min_hi, _mm_loadu_ps(min_main + i + 4));
+			grow_lo = _mm_add_ps(grow_lo, _mm_loadu_ps(grow + i));
+			grow_hi = _mm_add_ps(grow_hi, _mm_loadu_ps(grow + i + 4));
+		}
+
+		float min_lanes[flex_kernel_lanes];
+		float grow_lanes[flex_kernel_lanes];
+		_mm_storeu_ps(min_lanes, min_lo);
+		_mm_storeu_ps(min_lanes + 4, min_hi);
+		_mm_storeu_ps(grow_lanes, grow_lo);
+		_mm_storeu_ps(grow_lanes + 4, grow_hi);
+		AddToLanes(min_lanes, min_main, blocks, count);
+		AddToLanes(grow_lanes, grow, blocks, count);
+		return FlexLineSums{FoldFlexLanes(min_lanes), FoldFlexLanes(grow_lanes)};
+	}
+
+	void ComputeItemsSSE2(
+		FlexLineScratch& scratch,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept {
+		const __m128 extra_space = _mm_set1_ps(params.extra_space);
+		const __m128 total_grow = _mm_set1_ps(params.total_grow);
+		const __m128 gap = _mm_set1_ps(params.gap);
+		const __m128 cross_start = _mm_set1_ps(params.cross_start);
+		const __m128 cross_length = _mm_set1_ps(params.cross_length);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128i stretch = _mm_set1_epi32(static_cast<int>(Align::Stretch));
+		const __m128i end = _mm_set1_epi32(static_cast<int>(Align::End));
+		const __m128i center = _mm_set1_epi32(static_cast<int>(Align::Center));
+
+		const auto select = [](__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		};
+
+		const size_t blocks = count / 4 * 4;
+		for (size_t i = 0; i < blocks; i += 4) {
+			const __m128 min_main = _mm_loadu_ps(scratch.min_main.data() + i);
+			const __m128 min_cross = _mm_loadu_ps(scratch.min_cross.data() + i);
+			const __m128 grow = _mm_loadu_ps(scratch.grow.data() + i);
+			const __m128i align = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(scratch.align.data() + i)
+			);
+
+			const __m128 grown = _mm_add_ps(
+				min_main,
+				_mm_div_ps(_mm_mul_ps(extra_space, grow), total_grow)
+			);
+			const __m128 main_length = select(_mm_cmpgt_ps(grow, zero), grown, min_main);
+
+			const __m128 cross_length_item = select(
+				_mm_castsi128_ps(_mm_cmpeq_epi32(align, stretch)),
+				cross_length,
+				min_cross
+			);
+			const __m128 extra = _mm_sub_ps(cross_length, cross_length_item);
+			const __m128 offset = select(
+				_mm_castsi128_ps(_mm_cmpeq_epi32(align, end)),
+				extra,
+				select(
+					_mm_castsi128_ps(_mm_cmpeq_epi32(align, center)),
+					_mm_mul_ps(extra, half),
+					zero
+				)
+			);
+
+			_mm_storeu_ps(scratch.main_size.data() + i, main_length);
+			_mm_storeu_ps(scratch.cross_size.data() + i, cross_length_item);
+			_mm_storeu_ps(scratch.cross_position.data() + i, _mm_add_ps(cross_start, offset));
+			_mm_storeu_ps(scratch.main_position.data() + i, _mm_add_ps(main_length, gap));
+		}
+		ComputeItemsScalar(scratch, blocks, count, params);
+	}
+
+	KLAY_TARGET_AVX2
+	FlexLineSums SumAVX2(const FlexLineScratch& scratch, size_t count) noexcept {
+		const float* min_main = scratch.min_main.data();
+		const float* grow = scratch.grow.data();
+		__m256 min_sum = _mm256_setzero_ps();
+		__m256 grow_sum = _mm256_setzero_ps();
+
+		const size_t blocks = count / flex_kernel_lanes * flex_kernel_lanes;
+		for (size_t i = 0; i < blocks; i += flex_kernel_lanes) {
+			min_sum = _mm256_add_ps(min_sum, _mm256_loadu_ps(min_main + i));
+			grow_sum = _mm256_add_ps(grow_sum, _mm256_loadu_ps(grow + i));
+		}
+
+		float min_lanes[flex_kernel_lanes];
+		float grow_lanes[flex_kernel_lanes];
+		_mm256_storeu_ps(min_lanes, min_sum);
+		_mm256_storeu_ps(grow_lanes, grow_sum);
+		AddToLanes(min_lanes, min_main, blocks, count);
+		AddToLanes(grow_lanes, grow, blocks, count);
+		return FlexLineSums{FoldFlexLanes(min_lanes), FoldFlexLanes(grow_lanes)};
+	}
+
+	KLAY_TARGET_AVX2
+	void ComputeItemsAVX2(
+		FlexLineScratch& scratch,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept {
+		const __m256 extra_space = _mm256_set1_ps(params.extra_space);
+		const __m256 total_grow = _mm256_set1_ps(params.total_grow);
+		const __m256 gap = _mm256_set1_ps(params.gap);
+		const __m256 cross_start = _mm256_set1_ps(params.cross_start);
+		const __m256 cross_length = _mm256_set1_ps(params.cross_length);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i stretch = _mm256_set1_epi32(static_cast<int>(Align::Stretch));
+		const __m256i end = _mm256_set1_epi32(static_cast<int>(Align::End));
+		const __m256i center = _mm256_set1_epi32(static_cast<int>(Align::Center));
+
+		const size_t blocks = count / 8 * 8;
+		for (size_t i = 0; i < blocks; i += 8) {
+			const __m256 min_main = _mm256_loadu_ps(scratch.min_main.data() + i);
+			const __m256 min_cross = _mm256_loadu_ps(scratch.min_cross.data() + i);
+			const __m256 grow = _mm256_loadu_ps(scratch.grow.data() + i);
+			const __m256i align = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*>(scratch.align.data() + i)
+			);
+
+			const __m256 grown = _mm256_add_ps(
+				min_main,
+				_mm256_div_ps(_mm256_mul_ps(extra_space, grow), total_grow)
+			);
+			const __m256 main_length = _mm256_blendv_ps(
+				min_main,
+				grown,
+				_mm256_cmp_ps(grow, zero, _CMP_GT_OQ)
+			);
+
+			const __m256 cross_length_item = _mm256_blendv_ps(
+				min_cross,
+				cross_length,
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(align, stretch))
+			);
+			const __m256 extra = _mm256_sub_ps(cross_length, cross_length_item);
+			const __m256 offset = _mm256_blendv_ps(
+				_mm256_blendv_ps(
+					zero,
+					_mm256_mul_ps(extra, half),
+					_mm256_castsi256_ps(_mm256_cmpeq_epi32(align, center))
+				),
+				extra,
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(align, end))
+			);
+
+			_mm256_storeu_ps(scratch.main_size.data() + i, main_length);
+			_mm256_storeu_ps(scratch.cross_size.data() + i, cross_length_item);
+			_mm256_storeu_ps(scratch.cross_position.data() + i, _mm256_add_ps(cross_start, offset));
+			_mm256_storeu_ps(scratch.main_position.data() + i, _mm256_add_ps(main_length, gap));
+		}
+		ComputeItemsScalar(scratch, blocks, count, params);
+	}
+#endif
+
+#if KLAY_FLEX_KERNEL_NEON
+	// 8 lanes as two registers of 4
+	FlexLineSums SumNEON(const FlexLineScratch& scratch, size_t count) noexcept {
+		const float* min_main = scratch.min_main.data();
+		const float* grow = scratch.grow.data();
+		float32x4_t min_lo = vdupq_n_f32(0);
+		float32x4_t min_hi = vdupq_n_f32(0);
+		float32x4_t grow_lo = vdupq_n_f32(0);
+		float32x4_t grow_hi = vdupq_n_f32(0);
+
+		const size_t blocks = count / flex_kernel_lanes * flex_kernel_lanes;
+		for (size_t i = 0; i < blocks; i += flex_kernel_lanes) {
+			min_lo = vaddq_f32(min_lo, vld1q_f32(min_main + i));
+			min_hi = vaddq_f32(min_hi, vld1q_f32(min_main + i + 4));
+			grow_lo = vaddq_f32(grow_lo, vld1q_f32(grow + i));
+			grow_hi = vaddq_f32(grow_hi, vld1q_f32(grow + i + 4));
+		}
+
+		float min_lanes[flex_kernel_lanes];
+		float grow_lanes[flex_kernel_lanes];
+		vst1q_f32(min_lanes, min_lo);
+		vst1q_f32(min_lanes + 4, min_hi);
+		vst1q_f32(grow_lanes, grow_lo);
+		vst1q_f32(grow_lanes + 4, grow_hi);
+		AddToLanes(min_lanes, min_main, blocks, count);
+		AddToLanes(grow_lanes, grow, blocks, count);
+		return FlexLineSums{FoldFlexLanes(min_lanes), FoldFlexLanes(grow_lanes)};
+	}
+
+	void ComputeItemsNEON(
+		FlexLineScratch& scratch,
+		size_t count,
+		const FlexLineParams& params
+	) noexcept {
+		const float32x4_t extra_space = vdupq_n_f32(params.extra_space);
+		const float32x4_t total_grow = vdupq_n_f32(params.total_grow);
+		const float32x4_t gap = vdupq_n_f32(params.gap);
+		const float32x4_t cross_start = vdupq_n_f32(params.cross_start);
+		const float32x4_t cross_length = vdupq_n_f32(params.cross_length);
+		const float32x4_t half = vdupq_n_f32(0.5f);
+		const float32x4_t zero = vdupq_n_f32(0);
+		const uint32x4_t stretch = vdupq_n_u32(static_cast<std::uint32_t>(Align::Stretch));
+		const uint32x4_t end = vdupq_n_u32(static_cast<std::uint32_t>(Align::End));
+		const uint32x4_t center = vdupq_n_u32(static_cast<std::uint32_t>(Align::Center));
+
+		const size_t blocks = count / 4 * 4;
+		for (size_t i = 0; i < blocks; i += 4) {
+			const float32x4_t min_main = vld1q_f32(scratch.min_main.data() + i);
+			const float32x4_t min_cross = vld1q_f32(scratch.min_cross.data() + i);
+			const float32x4_t grow = vld1q_f32(scratch.grow.data() + i);
+			const uint32x4_t align = vld1q_u32(scratch.align.data() + i);
+
+			// separate multiply and add, a fused one would round differently
+			const float32x4_t grown = vaddq_f32(
+				min_main,
+				vdivq_f32(vmulq_f32(extra_space, grow), total_grow)
+			);
+			const float32x4_t main_length = vbslq_f32(vcgtq_f32(grow, zero), grown, min_main);
+
+			const float32x4_t cross_length_item = vbslq_f32(
+				vceqq_u32(align, stretch),
+				cross_length,
+				min_cross
+			);
+			const float32x4_t extra = vsubq_f32(cross_length, cross_length_item);
+			const float32x4_t offset = vbslq_f32(
+				vceqq_u32(align, end),
+				extra,
+				vbslq_f32(vceqq_u32(align, center), vmulq_f32(extra, half), zero)
+			);
+
+			vst1q_f32(scratch.main_size.data() + i, main_length);
+			vst1q_f32(scratch.cross_size.data() + i, cross_length_item);
+			vst1q_f32(scratch.cross_position.data() + i, vaddq_f32(cross_start, offset));
+			vst1q_f32(scratch.main_position.data() + i, vaddq_f32(main_length, gap));
+		}
+		ComputeItemsScalar(scratch, blocks, count, params);
+	}
+#endif
+
+	FlexKernelIsa DetectFlexKernelIsa() noexcept {
+#if KLAY_FLEX_KERNEL_X86
+	#if defined(__GNUC__)
+		if (__builtin_cpu_supports("avx2")) {
+			return FlexKernelIsa::AVX2;
+		}
+	#endif
+		return FlexKernelIsa::SSE2;
+#elif KLAY_FLEX_KERNEL_NEON
+		return FlexKernelIsa::NEON;
+#else
+		return FlexKernelIsa::Scalar;
+#endif
+	}
+
+	std::atomic<FlexKernelIsa> flex_kernel_isa { DetectFlexKernelIsa() };
+}
+
+Klay::FlexKernelIsa Klay::GetFlexKernelIsa() noexcept {
+	return flex_kernel_isa.load(std::memory_order_relaxed);
+}
+
+bool Klay::IsFlexKernelIsaSupported(FlexKernelIsa isa) noexcept {
+	switch (isa) {
+		case FlexKernelIsa::Scalar:
+			return true;
+#if KLAY_FLEX_KERNEL_X86
+		case FlexKernelIsa::SSE2:
+			return true;
+		case FlexKernelIsa::AVX2:
+			return DetectFlexKernelIsa() == FlexKernelIsa::AVX2;
+#elif KLAY_FLEX_KERNEL_NEON
+		case FlexKernelIsa::NEON:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+bool Klay::SetFlexKernelIsa(FlexKernelIsa isa) noexcept {
+	if (!IsFlexKernelIsaSupported(isa)) {
+		return false;
+	}
+	flex_kernel_isa.store(isa, std::memory_order_relaxed);
+	return true;
+}
+
+bool Klay::FlexLineScratch::Resize(size_t count) {
+	// every array is resized together, so they share a capacity
+	const bool grew = count > min_main.capacity();
+	min_main.resize(count);
+	min_cross.resize(count);
+	grow.resize(count);
+	align.resize(count);
+	main_size.resize(count);
+	cross_size.resize(count);
+	main_position.resize(count);
+	cross_position.resize(count);
+	return grew;
+}
+
+Klay::FlexLineScratch& Klay::GetFlexLineScratch() noexcept {
+	thread_local FlexLineScratch scratch;
+	return scratch;
+}
+
+Klay::FlexLineSums Klay::SumFlexLine(
+	const FlexLineScratch& scratch,
+	size_t count
+) noexcept {
+	switch (GetFlexKernelIsa()) {
+#if KLAY_FLEX_KERNEL_X86
+		case FlexKernelIsa::SSE2:
+			return SumSSE2(scratch, count);
+		case FlexKernelIsa::AVX2:
+			return SumAVX2(scratch, count);
+#elif KLAY_FLEX_KERNEL_NEON
+		case FlexKernelIsa::NEON:
+			return SumNEON(scratch, count);
+#endif
+		default:
+			return SumScalar(scratch, count);
+	}
+}
+
+void Klay::ComputeFlexLineItems(
+	FlexLineScratch& scratch,
+	size_t count,
+	const FlexLineParams& params
+) noexcept {
+	switch (GetFlexKernelIsa()) {
+#if KLAY_FLEX_KERNEL_X86
+		case FlexKernelIsa::SSE2:
+			ComputeItemsSSE2(scratch, count, params);
+			break;
+		case FlexKernelIsa::AVX2:
+			ComputeItemsAVX2(scratch, count, params);
+			break;
+#elif KLAY_FLEX_KERNEL_NEON
+		case FlexKernelIsa::NEON:
+			ComputeItemsNEON(scratch, count, params);
+			break;
+#endif
+		default:
+			ComputeItemsScalar(scratch, 0, count, params);
+			break;
+	}
+	ScanMainPositions(scratch, count, params);
+}
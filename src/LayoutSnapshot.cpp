@@ -0,0 +1,417 @@
+#include <klay/LayoutSnapshot.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+	using namespace Klay;
+
+	static_assert(std::numeric_limits<float>::is_iec559, "snapshots store IEEE floats");
+	static_assert(std::is_trivially_copyable_v<PxSize> && sizeof(PxSize) == 8);
+	static_assert(std::is_trivially_copyable_v<PxRect> && sizeof(PxRect) == 16);
+	static_assert(std::is_trivially_copyable_v<Unit> && sizeof(Unit) == 8);
+	static_assert(sizeof(LayoutSnapshotHeader) == 56);
+	static_assert(sizeof(LayoutSnapshotContainer) == 76);
+
+	constexpr std::uint32_t byte_order = 0x01020304;
+
+	constexpr size_t AlignUp(size_t offset) noexcept {
+		constexpr size_t alignment = LayoutSnapshot::alignment;
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// Byte offset of each section. Sections follow the header in this
+	// order, each aligned to LayoutSnapshot::alignment, so the offsets
+	// only depend on the counts in the header.
+	struct SectionOffsets {
+		size_t parent;
+		size_t first_child;
+		size_t num_children;
+		size_t min_size;
+		size_t preferred_size;
+		size_t max_size;
+		size_t padding_size;
+		size_t padding_fraction;
+		size_t grow;
+		size_t shrink;
+		size_t align_self;
+		size_t grid_placement;
+		size_t limited_children;
+		size_t container;
+		size_t containers;
+		size_t tracks;
+		size_t computed_rect;
+		size_t end;
+
+		SectionOffsets(const LayoutSnapshotHeader& header) noexcept {
+			const size_t nodes = header.num_nodes;
+			size_t offset = sizeof(LayoutSnapshotHeader);
+			const auto section = [&](size_t count, size_t element_size) {
+				const size_t start = AlignUp(offset);
+				offset = start + count * element_size;
+				return start;
+			};
+			parent = section(nodes, sizeof(NodeHandle));
+			first_child = section(nodes, sizeof(NodeHandle));
+			num_children = section(nodes, sizeof(NodeHandle));
+			min_size = section(nodes, sizeof(PxSize));
+			preferred_size = section(nodes, sizeof(PxSize));
+			max_size = section(nodes, sizeof(PxSize));
+			padding_size = section(nodes, sizeof(PxSize));
+			padding_fraction = section(nodes, sizeof(PxSize));
+			grow = section(nodes, sizeof(float));
+			shrink = section(nodes, sizeof(float));
+			align_self = section(nodes, sizeof(std::uint8_t));
+			grid_placement = section(nodes, sizeof(LayoutSnapshotPlacement));
+			limited_children = section(nodes, sizeof(std::uint8_t));
+			container = section(nodes, sizeof(NodeHandle));
+			containers = section(header.num_containers, sizeof(LayoutSnapshotContainer));
+			tracks = section(header.num_tracks, sizeof(LayoutSnapshotTrack));
+			computed_rect = section(header.has_geometry ? nodes : 0, sizeof(PxRect));
+			end = AlignUp(offset);
+		}
+	};
+
+	template<typename T>
+	void WriteSection(std::vector<std::byte>& data, size_t offset, std::span<const T> values) {
+		if (!values.empty()) {
+			std::memcpy(data.data() + offset, values.data(), values.size_bytes());
+		}
+	}
+
+	template<typename T>
+	std::span<const T> ReadSection(std::span<const std::byte> data, size_t offset, size_t count) noexcept {
+		return {reinterpret_cast<const T*>(data.data() + offset), count};
+	}
+
+	void AppendTracks(
+		std::vector<LayoutSnapshotTrack>& tracks,
+		const std::optional<GridTrackList>& track_list
+	) {
+		if (!track_list) {
+			return;
+		}
+		for (const auto& size : track_list->sizes) {
+			tracks.push_back(LayoutSnapshotTrack{
+				static_cast<std::uint32_t>(size.index()),
+				std::visit([](auto size) { return static_cast<float>(size.value); }, size),
+			});
+		}
+	}
+
+	std::optional<GridTrackList> ReadTracks(
+		std::span<const LayoutSnapshotTrack> tracks,
+		bool has_tracks
+	) {
+		if (!has_tracks) {
+			return std::nullopt;
+		}
+		GridTrackList track_list;
+		track_list.sizes.reserve(tracks.size());
+		for (const auto& track : tracks) {
+			switch (track.kind) {
+			case 0: track_list.sizes.emplace_back(GridFr{track.value}); break;
+			case 1: track_list.sizes.emplace_back(Px{track.value}); break;
+			default: track_list.sizes.emplace_back(Percent{track.value}); break;
+			}
+		}
+		return track_list;
+	}
+
+	LayoutOptions ReadLayoutOptions(const LayoutSnapshotContainer& container) noexcept {
+		LayoutOptions options;
+		options.main_gap = container.main_gap;
+		options.cross_gap = container.cross_gap;
+		for (int i = 0; i < 4; ++i) {
+			options.padding.axes[i / 2].edges[i % 2] = container.padding[i];
+		}
+		options.justify_content = static_cast<Justify>(container.justify_content);
+		options.align_items = static_cast<Align>(container.align_items);
+		options.justify_items = static_cast<Justify>(container.justify_items);
+		options.num_rows = container.num_rows;
+		options.num_columns = container.num_columns;
+		return options;
+	}
+
+	LayoutTree::LayoutModeVariant ReadLayoutMode(
+		const LayoutSnapshotContainer& container,
+		std::span<const LayoutSnapshotTrack> tracks
+	) {
+		if (container.mode == LayoutSnapshotMode::Flex) {
+			return FlexLayoutMode{
+				static_cast<Axis>(container.main_axis),
+				static_cast<FlexWrap>(container.wrap),
+			};
+		}
+
+		const auto row_tracks = tracks.subspan(container.first_track, container.num_row_tracks);
+		const auto col_tracks = tracks.subspan(
+			container.first_track + container.num_row_tracks,
+			container.num_col_tracks
+		);
+		GridLayoutMode grid;
+		grid.row_track_list = ReadTracks(row_tracks, container.has_row_tracks);
+		grid.col_track_list = ReadTracks(col_tracks, container.has_col_tracks);
+		return grid;
+	}
+}
+
+std::vector<std::byte> Klay::LayoutSnapshot::Write(
+	const LayoutTree& tree,
+	const std::optional<PxRect>& viewport
+) {
+	const size_t nodes = tree.Size();
+
+	std::vector<LayoutSnapshotContainer> containers;
+	std::vector<LayoutSnapshotTrack> tracks;
+	containers.reserve(tree.containers.size());
+	for (const auto& tree_container : tree.containers) {
+		const auto& options = tree_container.layout_options;
+		LayoutSnapshotContainer container {};
+		container.main_gap = options.main_gap;
+		container.cross_gap = options.cross_gap;
+		for (int i = 0; i < 4; ++i) {
+			container.padding[i] = options.padding.axes[i / 2].edges[i % 2];
+		}
+		container.num_rows = options.num_rows;
+		container.num_columns = options.num_columns;
+		container.justify_content = static_cast<std::uint8_t>(options.justify_content);
+		container.align_items = static_cast<std::uint8_t>(options.align_items);
+		container.justify_items = static_cast<std::uint8_t>(options.justify_items);
+
+		if (tree_container.grid == LayoutTree::null_handle) {
+			container.mode = LayoutSnapshotMode::Flex;
+			container.main_axis = static_cast<std::uint8_t>(tree_container.flex.main_axis);
+			container.wrap = static_cast<std::uint8_t>(tree_container.flex.wrap);
+		}
+		else {
+			const auto& grid = tree.grids[tree_container.grid];
+			container.mode = LayoutSnapshotMode::Grid;
+			container.has_row_tracks = grid.row_track_list.has_value();
+			container.has_col_tracks = grid.col_track_list.has_value();
+			container.first_track = static_cast<std::uint32_t>(tracks.size());
+			AppendTracks(tracks, grid.row_track_list);
+			container.num_row_tracks = static_cast<std::uint32_t>(tracks.size()) - container.first_track;
+			AppendTracks(tracks, grid.col_track_list);
+			container.num_col_tracks = static_cast<std::uint32_t>(tracks.size())
+				- container.first_track - container.num_row_tracks;
+		}
+		containers.push_back(container);
+	}
+
+	LayoutSnapshotHeader header {};
+	std::copy(std::begin(magic), std::end(magic), header.magic);
+	header.version = version;
+	header.byte_order = byte_order;
+	header.num_nodes = static_cast<std::uint32_t>(nodes);
+	header.num_containers = static_cast<std::uint32_t>(containers.size());
+	header.num_tracks = static_cast<std::uint32_t>(tracks.size());
+	header.has_geometry = viewport.has_value();
+	header.viewport = viewport.value_or(PxRect{});
+
+	const SectionOffsets offsets{header};
+	header.size = offsets.end;
+
+	std::vector<std::byte> data(offsets.end);
+	std::memcpy(data.data(), &header, sizeof(header));
+	WriteSection<NodeHandle>(data, offsets.parent, tree.parent);
+	WriteSection<NodeHandle>(data, offsets.first_child, tree.first_child);
+	WriteSection<NodeHandle>(data, offsets.num_children, tree.num_children);
+	WriteSection<PxSize>(data, offsets.min_size, tree.min_size);
+	WriteSection<PxSize>(data, offsets.max_size, tree.max_size);
+	WriteSection<PxSize>(data, offsets.padding_size, tree.padding_size);
+	WriteSection<PxSize>(data, offsets.padding_fraction, tree.padding_fraction);
+	WriteSection<float>(data, offsets.grow, tree.grow);
+	WriteSection<float>(data, offsets.shrink, tree.shrink);
+	WriteSection<std::uint8_t>(data, offsets.limited_children, tree.limited_children);
+	WriteSection<NodeHandle>(data, offsets.container, tree.container);
+	WriteSection<LayoutSnapshotContainer>(data, offsets.containers, containers);
+	WriteSection<LayoutSnapshotTrack>(data, offsets.tracks, tracks);
+
+	std::vector<PxSize> preferred_size(nodes);
+	std::vector<std::uint8_t> align_self(nodes);
+	std::vector<LayoutSnapshotPlacement> grid_placement(nodes);
+	for (size_t i = 0; i < nodes; ++i) {
+		preferred_size[i] = tree.preferred_size[i].Transform([](const std::optional<Px>& length, Axis) {
+			return length.value_or(Px{layout_snapshot_no_size});
+		});
+		align_self[i] = tree.align_self[i]
+			? static_cast<std::uint8_t>(*tree.align_self[i])
+			: layout_snapshot_no_align;
+		const auto& placement = tree.grid_placement[i];
+		grid_placement[i] = LayoutSnapshotPlacement{
+			placement.row_start.value_or(layout_snapshot_auto_track),
+			placement.row_span,
+			placement.col_start.value_or(layout_snapshot_auto_track),
+			placement.col_span,
+		};
+	}
+	WriteSection<PxSize>(data, offsets.preferred_size, preferred_size);
+	WriteSection<std::uint8_t>(data, offsets.align_self, align_self);
+	WriteSection<LayoutSnapshotPlacement>(data, offsets.grid_placement, grid_placement);
+
+	if (viewport) {
+		LayoutTree laid_out = tree;
+		laid_out.ComputeLayout(*viewport);
+		std::vector<PxRect> rects(nodes);
+		for (size_t i = 0; i < nodes; ++i) {
+			rects[i] = laid_out.ComputedRect(static_cast<NodeHandle>(i));
+		}
+		WriteSection<PxRect>(data, offsets.computed_rect, rects);
+	}
+	return data;
+}
+
+std::optional<Klay::LayoutSnapshot> Klay::LayoutSnapshot::Open(
+	std::span<const std::byte> data
+) noexcept {
+	if (reinterpret_cast<std::uintptr_t>(data.data()) % alignment != 0
+		|| data.size() < sizeof(LayoutSnapshotHeader)
+	) {
+		return std::nullopt;
+	}
+
+	LayoutSnapshotHeader header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (!std::equal(std::begin(magic), std::end(magic), header.magic)
+		|| header.version != version
+		|| header.byte_order != byte_order
+	) {
+		return std::nullopt;
+	}
+
+	const SectionOffsets offsets{header};
+	if (header.size != offsets.end || data.size() < offsets.end) {
+		return std::nullopt;
+	}
+
+	// the containers are few, so check that their tracks are in range
+	// here rather than on every read
+	const auto containers = ReadSection<LayoutSnapshotContainer>(
+		data,
+		offsets.containers,
+		header.num_containers
+	);
+	for (const auto& container : containers) {
+		const auto tracks_end = std::uint64_t{container.first_track}
+			+ container.num_row_tracks
+			+ container.num_col_tracks;
+		if ((container.mode != LayoutSnapshotMode::Flex && container.mode != LayoutSnapshotMode::Grid)
+			|| tracks_end > header.num_tracks
+		) {
+			return std::nullopt;
+		}
+	}
+
+	const size_t nodes = header.num_nodes;
+	LayoutSnapshot snapshot;
+	snapshot.parent = ReadSection<NodeHandle>(data, offsets.parent, nodes);
+	snapshot.first_child = ReadSection<NodeHandle>(data, offsets.first_child, nodes);
+	snapshot.num_children = ReadSection<NodeHandle>(data, offsets.num_children, nodes);
+	snapshot.min_size = ReadSection<PxSize>(data, offsets.min_size, nodes);
+	snapshot.preferred_size = ReadSection<PxSize>(data, offsets.preferred_size, nodes);
+	snapshot.max_size = ReadSection<PxSize>(data, offsets.max_size, nodes);
+	snapshot.padding_size = ReadSection<PxSize>(data, offsets.padding_size, nodes);
+	snapshot.padding_fraction = ReadSection<PxSize>(data, offsets.padding_fraction, nodes);
+	snapshot.grow = ReadSection<float>(data, offsets.grow, nodes);
+	snapshot.shrink = ReadSection<float>(data, offsets.shrink, nodes);
+	snapshot.align_self = ReadSection<std::uint8_t>(data, offsets.align_self, nodes);
+	snapshot.grid_placement = ReadSection<LayoutSnapshotPlacement>(data, offsets.grid_placement, nodes);
+	snapshot.limited_children = ReadSection<std::uint8_t>(data, offsets.limited_children, nodes);
+	snapshot.container = ReadSection<NodeHandle>(data, offsets.container, nodes);
+	snapshot.containers = containers;
+	snapshot.tracks = ReadSection<LayoutSnapshotTrack>(data, offsets.tracks, header.num_tracks);
+	snapshot.computed_rect = ReadSection<PxRect>(data, offsets.computed_rect, header.has_geometry ? nodes : 0);
+	snapshot.viewport = header.viewport;
+	return snapshot;
+}
+
+std::span<const Klay::PxRect> Klay::LayoutSnapshot::RectsFor(const PxRect& other) const noexcept {
+	if (other == viewport) {
+		return computed_rect;
+	}
+	return {};
+}
+
+Klay::OptionalPxSize Klay::LayoutSnapshot::GetPreferredSize(NodeHandle node) const noexcept {
+	return preferred_size[node].Transform([](Px length, Axis) -> std::optional<Px> {
+		if (std::isnan(length.value)) {
+			return std::nullopt;
+		}
+		return length;
+	});
+}
+
+std::optional<Klay::Align> Klay::LayoutSnapshot::GetAlignSelf(NodeHandle node) const noexcept {
+	if (align_self[node] == layout_snapshot_no_align) {
+		return std::nullopt;
+	}
+	return static_cast<Align>(align_self[node]);
+}
+
+Klay::GridItemPlacement Klay::LayoutSnapshot::GetGridPlacement(NodeHandle node) const noexcept {
+	const auto& placement = grid_placement[node];
+	const auto track = [](std::int32_t start) -> std::optional<int> {
+		if (start == layout_snapshot_auto_track) {
+			return std::nullopt;
+		}
+		return start;
+	};
+	return GridItemPlacement{
+		track(placement.row_start),
+		placement.row_span,
+		track(placement.col_start),
+		placement.col_span,
+	};
+}
+
+Klay::LayoutOptions Klay::LayoutSnapshot::GetLayoutOptions(NodeHandle node) const noexcept {
+	assert(container[node] < containers.size() && "node has no container");
+	return ReadLayoutOptions(containers[container[node]]);
+}
+
+Klay::LayoutTree::LayoutModeVariant Klay::LayoutSnapshot::GetLayoutMode(NodeHandle node) const {
+	assert(container[node] < containers.size() && "node has no container");
+	return ReadLayoutMode(containers[container[node]], tracks);
+}
+
+Klay::LayoutTree Klay::LayoutSnapshot::ToLayoutTree() const {
+	LayoutTree tree;
+	tree.parent.assign(parent.begin(), parent.end());
+	tree.first_child.assign(first_child.begin(), first_child.end());
+	tree.num_children.assign(num_children.begin(), num_children.end());
+	tree.min_size.assign(min_size.begin(), min_size.end());
+	tree.max_size.assign(max_size.begin(), max_size.end());
+	tree.padding_size.assign(padding_size.begin(), padding_size.end());
+	tree.padding_fraction.assign(padding_fraction.begin(), padding_fraction.end());
+	tree.grow.assign(grow.begin(), grow.end());
+	tree.shrink.assign(shrink.begin(), shrink.end());
+	tree.limited_children.assign(limited_children.begin(), limited_children.end());
+	tree.container.assign(container.begin(), container.end());
+
+	tree.preferred_size.resize(Size());
+	tree.align_self.resize(Size());
+	tree.grid_placement.resize(Size());
+	for (NodeHandle node = 0; node < Size(); ++node) {
+		tree.preferred_size[node] = GetPreferredSize(node);
+		tree.align_self[node] = GetAlignSelf(node);
+		tree.grid_placement[node] = GetGridPlacement(node);
+	}
+	tree.percent_padding_children.resize(Size());
+	tree.computed_min_size.resize(Size());
+	tree.computed_size.resize(Size());
+	tree.computed_position.resize(Size());
+
+	tree.containers.reserve(containers.size());
+	for (const auto& snapshot_container : containers) {
+		tree.AddContainer(
+			ReadLayoutMode(snapshot_container, tracks),
+			ReadLayoutOptions(snapshot_container)
+		);
+	}
+	return tree;
+}
@@ -0,0 +1,505 @@
+#include <klay/LayoutTrace.hpp>
+#include <klay/Element.hpp>
+#include <klay/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+std::atomic<bool> Klay::Detail::layout_trace_recording = false;
+
+namespace {
+	using namespace Klay;
+
+	constexpr char trace_magic[4] { 'K', 'L', 'T', 'R' };
+	constexpr std::uint32_t trace_version = 1;
+	// written in the byte order of the recorder
+	constexpr std::uint32_t trace_byte_order = 0x01020304;
+
+	enum class TraceEvent : std::uint8_t {
+		// id, then the options of the element, see WriteElementState.
+		// Creates the element if id is the next unused id.
+		Element,
+		// parent id, child id
+		AddChild,
+		// kind, id, rect, min parallel size, recorded nanoseconds
+		Call,
+	};
+
+	enum class TraceMode : std::uint8_t {
+		None,
+		Flex,
+		Grid,
+	};
+
+	template<typename T>
+	void Put(std::vector<std::byte>& out, const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		const auto offset = out.size();
+		out.resize(offset + sizeof(T));
+		std::memcpy(out.data() + offset, &value, sizeof(T));
+	}
+
+	template<typename T>
+	void PutOptional(std::vector<std::byte>& out, const std::optional<T>& value) {
+		Put<std::uint8_t>(out, value.has_value());
+		if (value) {
+			Put(out, *value);
+		}
+	}
+
+	void PutTracks(std::vector<std::byte>& out, const std::optional<GridTrackList>& track_list) {
+		Put<std::uint8_t>(out, track_list.has_value());
+		if (!track_list) {
+			return;
+		}
+		Put(out, static_cast<std::uint32_t>(track_list->sizes.size()));
+		for (const auto& size : track_list->sizes) {
+			Put(out, static_cast<std::uint8_t>(size.index()));
+			Put(out, std::visit([](auto size) { return static_cast<float>(size.value); }, size));
+		}
+	}
+
+	// The layout mode comes last, so that replay can compare it alone
+	// and only replace it when it changed, keeping its caches otherwise
+	void WriteElementState(std::vector<std::byte>& out, const Element& element) {
+		for (const auto* range : {&element.size.min, &element.size.value, &element.size.max}) {
+			PutOptional(out, range->axes[0]);
+			PutOptional(out, range->axes[1]);
+		}
+
+		const auto& options = element.layout_options;
+		Put(out, options.main_gap);
+		Put(out, options.cross_gap);
+		for (int i = 0; i < 4; ++i) {
+			Put(out, options.padding.axes[i / 2].edges[i % 2]);
+		}
+		Put(out, static_cast<std::uint8_t>(options.justify_content));
+		Put(out, static_cast<std::uint8_t>(options.align_items));
+		Put(out, static_cast<std::uint8_t>(options.justify_items));
+		Put<std::int32_t>(out, options.num_rows);
+		Put<std::int32_t>(out, options.num_columns);
+
+		const auto& item = element.item_options;
+		PutOptional(out, item.align_self);
+		PutOptional(out, item.justify_self);
+		PutOptional(out, item.basis);
+		Put(out, item.grow);
+		Put(out, item.shrink);
+		PutOptional<std::int32_t>(out, item.row_start);
+		Put<std::int32_t>(out, item.row_span);
+		PutOptional<std::int32_t>(out, item.col_start);
+		Put<std::int32_t>(out, item.col_span);
+
+		const auto& layout_mode = element.layout_mode;
+		if (const auto* flex = layout_mode.GetIf<FlexLayoutMode>()) {
+			Put(out, TraceMode::Flex);
+			Put(out, static_cast<std::uint8_t>(flex->main_axis));
+			Put(out, static_cast<std::uint8_t>(flex->wrap));
+		}
+		else if (const auto* grid = layout_mode.GetIf<GridLayoutMode>()) {
+			Put(out, TraceMode::Grid);
+			PutTracks(out, grid->row_track_list);
+			PutTracks(out, grid->col_track_list);
+		}
+		else {
+			Put(out, TraceMode::None);
+		}
+	}
+
+	struct Recorder {
+		struct RecordedElement {
+			std::uint32_t id;
+			// tells apart a destroyed element from a new one at the same
+			// address, for elements owned by a shared_ptr
+			std::weak_ptr<const Element> owner;
+			bool shared;
+		};
+
+		std::vector<std::byte> trace;
+		std::unordered_map<const Element*, RecordedElement> ids;
+		// last recorded state of each element
+		std::vector<std::vector<std::byte>> states;
+		std::vector<std::byte> scratch;
+
+		std::optional<std::uint32_t> Find(const Element& element) {
+			const auto it = ids.find(&element);
+			if (it == ids.end()) {
+				return std::nullopt;
+			}
+			if (it->second.shared && it->second.owner.expired()) {
+				ids.erase(it);
+				return std::nullopt;
+			}
+			return it->second.id;
+		}
+
+		// records element and its subtree unless they are already
+		std::uint32_t Record(const Element& element) {
+			if (const auto id = Find(element)) {
+				return *id;
+			}
+
+			const auto id = static_cast<std::uint32_t>(states.size());
+			auto owner = element.weak_from_this();
+			const bool shared = !owner.expired();
+			ids.emplace(&element, RecordedElement{id, std::move(owner), shared});
+
+			states.emplace_back();
+			WriteElementState(states.back(), element);
+			PutElement(id, states.back());
+
+			for (const auto& child : element) {
+				const auto child_id = Record(*child);
+				PutAddChild(id, child_id);
+			}
+			return id;
+		}
+
+		void PutElement(std::uint32_t id, const std::vector<std::byte>& state) {
+			Put(trace, TraceEvent::Element);
+			Put(trace, id);
+			trace.insert(trace.end(), state.begin(), state.end());
+		}
+
+		void PutAddChild(std::uint32_t parent, std::uint32_t child) {
+			Put(trace, TraceEvent::AddChild);
+			Put(trace, parent);
+			Put(trace, child);
+		}
+	};
+
+	std::mutex recorder_mutex;
+	std::unique_ptr<Recorder> recorder;
+
+	// whether this thread is in a recorded layout call
+	thread_local bool in_trace_call = false;
+
+	struct TraceReader {
+		std::span<const std::byte> data;
+		size_t offset = 0;
+		bool ok = true;
+
+		bool AtEnd() const noexcept {
+			return offset == data.size();
+		}
+
+		template<typename T>
+		T Get() noexcept {
+			T value {};
+			if (data.size() - offset < sizeof(T)) {
+				ok = false;
+				offset = data.size();
+				return value;
+			}
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return value;
+		}
+
+		template<typename T>
+		std::optional<T> GetOptional() noexcept {
+			if (!Get<std::uint8_t>()) {
+				return std::nullopt;
+			}
+			return Get<T>();
+		}
+
+		std::optional<GridTrackList> GetTracks() {
+			if (!Get<std::uint8_t>()) {
+				return std::nullopt;
+			}
+			GridTrackList track_list;
+			const auto count = Get<std::uint32_t>();
+			for (std::uint32_t i = 0; i < count && ok; ++i) {
+				const auto kind = Get<std::uint8_t>();
+				const auto value = Get<float>();
+				switch (kind) {
+				case 0: track_list.sizes.emplace_back(GridFr{value}); break;
+				case 1: track_list.sizes.emplace_back(Px{value}); break;
+				default: track_list.sizes.emplace_back(Percent{value}); break;
+				}
+			}
+			return track_list;
+		}
+
+		// reads the options of WriteElementState into element,
+		// and returns the bytes of the layout mode
+		std::span<const std::byte> GetElementState(Element& element) {
+			for (auto* range : {&element.size.min, &element.size.value, &element.size.max}) {
+				range->axes[0] = GetOptional<Unit>();
+				range->axes[1] = GetOptional<Unit>();
+			}
+
+			auto& options = element.layout_options;
+			options.main_gap = Get<Unit>();
+			options.cross_gap = Get<Unit>();
+			for (int i = 0; i < 4; ++i) {
+				options.padding.axes[i / 2].edges[i % 2] = Get<Unit>();
+			}
+			options.justify_content = static_cast<Justify>(Get<std::uint8_t>());
+			options.align_items = static_cast<Align>(Get<std::uint8_t>());
+			options.justify_items = static_cast<Justify>(Get<std::uint8_t>());
+			options.num_rows = Get<std::int32_t>();
+			options.num_columns = Get<std::int32_t>();
+
+			auto& item = element.item_options;
+			item.align_self = GetOptional<Align>();
+			item.justify_self = GetOptional<Justify>();
+			item.basis = GetOptional<Unit>();
+			item.grow = Get<float>();
+			item.shrink = Get<float>();
+			item.row_start = GetOptional<std::int32_t>();
+			item.row_span = Get<std::int32_t>();
+			item.col_start = GetOptional<std::int32_t>();
+			item.col_span = Get<std::int32_t>();
+
+			const auto mode_start = offset;
+			switch (Get<TraceMode>()) {
+			case TraceMode::Flex:
+				Get<std::uint8_t>();
+				Get<std::uint8_t>();
+				break;
+			case TraceMode::Grid:
+				GetTracks();
+				GetTracks();
+				break;
+			default:
+				break;
+			}
+			return data.subspan(mode_start, offset - mode_start);
+		}
+	};
+
+	ElementLayoutMode ReadLayoutMode(std::span<const std::byte> mode) {
+		TraceReader reader{mode};
+		switch (reader.Get<TraceMode>()) {
+		case TraceMode::Flex: {
+			const auto axis = static_cast<Axis>(reader.Get<std::uint8_t>());
+			const auto wrap = static_cast<FlexWrap>(reader.Get<std::uint8_t>());
+			return FlexLayoutMode{axis, wrap};
+		}
+		case TraceMode::Grid: {
+			GridLayoutMode grid;
+			grid.row_track_list = reader.GetTracks();
+			grid.col_track_list = reader.GetTracks();
+			return grid;
+		}
+		default:
+			return nullptr;
+		}
+	}
+}
+
+void Klay::StartLayoutTrace() {
+	std::lock_guard lock{recorder_mutex};
+	recorder = std::make_unique<Recorder>();
+	auto& trace = recorder->trace;
+	trace.insert(
+		trace.end(),
+		reinterpret_cast<const std::byte*>(std::begin(trace_magic)),
+		reinterpret_cast<const std::byte*>(std::end(trace_magic))
+	);
+	Put(trace, trace_version);
+	Put(trace, trace_byte_order);
+	Detail::layout_trace_recording.store(true, std::memory_order_relaxed);
+}
+
+std::vector<std::byte> Klay::StopLayoutTrace() {
+	std::lock_guard lock{recorder_mutex};
+	Detail::layout_trace_recording.store(false, std::memory_order_relaxed);
+	if (!recorder) {
+		return {};
+	}
+	auto trace = std::move(recorder->trace);
+	recorder.reset();
+	return trace;
+}
+
+void Klay::Detail::TraceAddChild(const Element& parent, const Element& child) {
+	std::lock_guard lock{recorder_mutex};
+	if (!recorder) {
+		return;
+	}
+	const auto parent_id = recorder->Record(parent);
+	const auto child_id = recorder->Record(child);
+	recorder->PutAddChild(parent_id, child_id);
+}
+
+void Klay::Detail::TraceMarkDirty(const Element& element) {
+	std::lock_guard lock{recorder_mutex};
+	if (!recorder) {
+		return;
+	}
+	const auto id = recorder->Find(element);
+	if (!id) {
+		recorder->Record(element);
+		return;
+	}
+
+	// setters mark the element dirty whether or not the value changed,
+	// so only record options that differ from the last recorded ones
+	auto& scratch = recorder->scratch;
+	scratch.clear();
+	WriteElementState(scratch, element);
+	auto& state = recorder->states[*id];
+	if (scratch != state) {
+		std::swap(state, scratch);
+		recorder->PutElement(*id, state);
+	}
+}
+
+std::ptrdiff_t Klay::Detail::BeginTraceCall(
+	LayoutTraceCallKind kind,
+	const Element& element,
+	const PxRect& rect,
+	std::uint32_t min_parallel_size
+) {
+	if (in_trace_call) {
+		return -1;
+	}
+	std::lock_guard lock{recorder_mutex};
+	if (!recorder) {
+		return -1;
+	}
+	in_trace_call = true;
+
+	const auto id = recorder->Record(element);
+	auto& trace = recorder->trace;
+	Put(trace, TraceEvent::Call);
+	Put(trace, kind);
+	Put(trace, id);
+	Put(trace, rect);
+	Put(trace, min_parallel_size);
+	// the time is filled in once the call returns
+	const auto time_offset = static_cast<std::ptrdiff_t>(trace.size());
+	Put<std::int64_t>(trace, 0);
+	return time_offset;
+}
+
+void Klay::Detail::EndTraceCall(std::ptrdiff_t call, std::chrono::nanoseconds elapsed) noexcept {
+	in_trace_call = false;
+	std::lock_guard lock{recorder_mutex};
+	if (!recorder || recorder->trace.size() < static_cast<size_t>(call) + sizeof(std::int64_t)) {
+		return;
+	}
+	const std::int64_t ns = elapsed.count();
+	std::memcpy(recorder->trace.data() + call, &ns, sizeof(ns));
+}
+
+std::optional<std::vector<Klay::LayoutTraceCall>> Klay::ReplayLayoutTrace(
+	std::span<const std::byte> trace,
+	ThreadPool* pool,
+	std::vector<std::shared_ptr<Element>>* replayed
+) {
+	TraceReader reader{trace};
+	char magic[4];
+	for (auto& c : magic) {
+		c = reader.Get<char>();
+	}
+	if (!std::equal(std::begin(magic), std::end(magic), std::begin(trace_magic))
+		|| reader.Get<std::uint32_t>() != trace_version
+		|| reader.Get<std::uint32_t>() != trace_byte_order
+	) {
+		return std::nullopt;
+	}
+
+	std::vector<std::shared_ptr<Element>> elements;
+	// layout mode bytes each element was last given
+	std::vector<std::span<const std::byte>> modes;
+	std::vector<LayoutTraceCall> calls;
+	DamageList damage;
+
+	const auto get_id = [&] {
+		const auto id = reader.Get<std::uint32_t>();
+		if (id >= elements.size()) {
+			reader.ok = false;
+		}
+		return id;
+	};
+
+	while (reader.ok && !reader.AtEnd()) {
+		switch (reader.Get<TraceEvent>()) {
+		case TraceEvent::Element: {
+			const auto id = reader.Get<std::uint32_t>();
+			const bool created = id == elements.size();
+			if (created) {
+				elements.push_back(std::make_shared<Element>());
+				modes.emplace_back();
+			}
+			else if (id > elements.size()) {
+				return std::nullopt;
+			}
+
+			auto& element = *elements[id];
+			const auto mode = reader.GetElementState(element);
+			if (!std::ranges::equal(mode, modes[id])) {
+				modes[id] = mode;
+				element.layout_mode = ReadLayoutMode(mode);
+			}
+			if (!created) {
+				element.MarkDirty();
+			}
+			break;
+		}
+		case TraceEvent::AddChild: {
+			const auto parent = get_id();
+			const auto child = get_id();
+			if (reader.ok) {
+				elements[parent]->AddChild(elements[child]);
+			}
+			break;
+		}
+		case TraceEvent::Call: {
+			LayoutTraceCall call {};
+			call.kind = reader.Get<LayoutTraceCallKind>();
+			call.element = get_id();
+			call.rect = reader.Get<PxRect>();
+			const auto min_parallel_size = reader.Get<std::uint32_t>();
+			call.recorded_time = std::chrono::nanoseconds{reader.Get<std::int64_t>()};
+			if (!reader.ok) {
+				break;
+			}
+
+			auto* element = elements[call.element].get();
+			const auto start = std::chrono::steady_clock::now();
+			switch (call.kind) {
+			case LayoutTraceCallKind::Layout:
+				element->ComputeLayout(call.rect);
+				break;
+			case LayoutTraceCallKind::ParallelTreeLayout:
+				if (pool) {
+					element->ComputeTreeLayout(call.rect, *pool, min_parallel_size);
+				}
+				else {
+					element->ComputeTreeLayout(call.rect);
+				}
+				break;
+			case LayoutTraceCallKind::DamageTreeLayout:
+				element->ComputeTreeLayout(call.rect, damage);
+				break;
+			default:
+				element->ComputeTreeLayout(call.rect);
+				break;
+			}
+			call.replay_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start
+			);
+			calls.push_back(call);
+			break;
+		}
+		default:
+			return std::nullopt;
+		}
+	}
+
+	if (!reader.ok) {
+		return std::nullopt;
+	}
+	if (replayed) {
+		*replayed = std::move(elements);
+	}
+	return calls;
+}
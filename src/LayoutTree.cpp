@@ -0,0 +1,285 @@
+#include <klay/LayoutTree.hpp>
+#include <klay/Element.hpp>
+#include <klay/Stats.hpp>
+
+#include <cassert>
+
+Klay::LayoutTree Klay::LayoutTree::FromElement(
+	const Element& root,
+	std::vector<const Element*>* elements
+) {
+	LayoutTree tree;
+
+	// breadth first, so the children of each element are contiguous
+	std::vector<const Element*> queue { &root };
+	tree.AddRoot();
+
+	for (size_t head = 0; head < queue.size(); ++head) {
+		const Element& element = *queue[head];
+		const auto node = static_cast<NodeHandle>(head);
+
+		OptionalPxSize preferred_size;
+		PxSize max_size = unbounded_size;
+		for (int axis = 0; axis < 2; ++axis) {
+			const auto min = element.size.min.axes[axis].value_or(Px{0});
+			tree.min_size[node].axes[axis] = min.TryGet<Px>().value_or(Px{0});
+			if (const auto preferred = element.size.value.axes[axis]) {
+				preferred_size.axes[axis] = preferred->TryGet<Px>();
+			}
+			if (const auto max = element.size.max.axes[axis]) {
+				max_size.axes[axis] = max->TryGet<Px>().value_or(unbounded_size.axes[axis]);
+			}
+
+		}
+		const auto padding = SumPadding(element.layout_options.padding);
+		tree.padding_size[node] = padding.px;
+		tree.padding_fraction[node] = padding.fraction;
+		tree.SetSizeLimits(node, preferred_size, max_size);
+
+		const auto& item_options = element.item_options;
+		tree.grow[node] = item_options.grow;
+		tree.shrink[node] = item_options.shrink;
+		tree.align_self[node] = item_options.align_self;
+		tree.grid_placement[node] = GridItemPlacement{
+			item_options.row_start,
+			item_options.row_span,
+			item_options.col_start,
+			item_options.col_span,
+		};
+
+		const auto& layout_mode = element.layout_mode;
+		if (auto flex = layout_mode.GetIf<FlexLayoutMode>()) {
+			tree.SetLayoutMode(node, *flex, element.layout_options);
+		}
+		else if (auto grid = layout_mode.GetIf<GridLayoutMode>()) {
+			tree.SetLayoutMode(node, *grid, element.layout_options);
+		}
+
+		if (element.NumChildren() > 0) {
+			tree.AddChildren(node, static_cast<NodeHandle>(element.NumChildren()));
+			for (const auto& child : element) {
+				queue.push_back(child.get());
+			}
+		}
+	}
+
+	if (elements) {
+		*elements = std::move(queue);
+	}
+	return tree;
+}
+
+void Klay::LayoutTree::Reserve(size_t count) {
+	parent.reserve(count);
+	first_child.reserve(count);
+	num_children.reserve(count);
+	min_size.reserve(count);
+	preferred_size.reserve(count);
+	max_size.reserve(count);
+	padding_size.reserve(count);
+	padding_fraction.reserve(count);
+	grow.reserve(count);
+	shrink.reserve(count);
+	align_self.reserve(count);
+	grid_placement.reserve(count);
+	computed_min_size.reserve(count);
+	limited_children.reserve(count);
+	percent_padding_children.reserve(count);
+	computed_size.reserve(count);
+	computed_position.reserve(count);
+	container.reserve(count);
+}
+
+Klay::NodeHandle Klay::LayoutTree::AddRoot() {
+	const auto node = static_cast<NodeHandle>(Size());
+	parent.push_back(null_handle);
+	first_child.push_back(null_handle);
+	num_children.push_back(0);
+	min_size.emplace_back(Px{0}, Px{0});
+	preferred_size.emplace_back();
+	max_size.push_back(unbounded_size);
+	padding_size.emplace_back(Px{0}, Px{0});
+	padding_fraction.emplace_back(Px{0}, Px{0});
+	grow.push_back(0);
+	shrink.push_back(0);
+	align_self.emplace_back();
+	grid_placement.emplace_back();
+	computed_min_size.emplace_back(Px{0}, Px{0});
+	limited_children.push_back(false);
+	percent_padding_children.push_back(false);
+	computed_size.emplace_back(Px{0}, Px{0});
+	computed_position.emplace_back(Px{0}, Px{0});
+	container.push_back(null_handle);
+	return node;
+}
+
+Klay::NodeHandle Klay::LayoutTree::AddChildren(
+	NodeHandle parent_node,
+	NodeHandle count
+) {
+	assert(num_children[parent_node] == 0 && "children of a node must be added at once");
+
+	const auto first = static_cast<NodeHandle>(Size());
+	for (NodeHandle i = 0; i < count; ++i) {
+		parent[AddRoot()] = parent_node;
+	}
+	first_child[parent_node] = first;
+	num_children[parent_node] = count;
+	return first;
+}
+
+void Klay::LayoutTree::SetSizeLimits(
+	NodeHandle node,
+	const OptionalPxSize& preferred,
+	const PxSize& max
+) noexcept {
+	preferred_size[node] = preferred;
+	max_size[node] = max;
+	if (parent[node] != null_handle && (preferred != OptionalPxSize{} || max != unbounded_size)) {
+		limited_children[parent[node]] = true;
+	}
+}
+
+void Klay::LayoutTree::SetLayoutMode(
+	NodeHandle node,
+	LayoutModeVariant mode,
+	const LayoutOptions& options
+) {
+	if (container[node] == null_handle) {
+		container[node] = AddContainer(std::move(mode), options);
+		return;
+	}
+
+	auto& node_container = containers[container[node]];
+	node_container.layout_options = options;
+	if (auto* grid = std::get_if<GridLayoutMode>(&mode)) {
+		if (node_container.grid == null_handle) {
+			node_container.grid = static_cast<NodeHandle>(grids.size());
+			grids.push_back(std::move(*grid));
+		}
+		else {
+			grids[node_container.grid] = std::move(*grid);
+		}
+	}
+	else {
+		node_container.flex = std::get<FlexLayoutMode>(std::move(mode));
+		node_container.grid = null_handle;
+	}
+}
+
+Klay::NodeHandle Klay::LayoutTree::AddContainer(
+	LayoutModeVariant mode,
+	const LayoutOptions& options
+) {
+	Container new_container;
+	new_container.layout_options = options;
+	if (auto* grid = std::get_if<GridLayoutMode>(&mode)) {
+		new_container.grid = static_cast<NodeHandle>(grids.size());
+		grids.push_back(std::move(*grid));
+	}
+	else {
+		new_container.flex = std::get<FlexLayoutMode>(std::move(mode));
+	}
+	containers.push_back(std::move(new_container));
+	return static_cast<NodeHandle>(containers.size() - 1);
+}
+
+Klay::LayoutTree::LayoutModeVariant Klay::LayoutTree::GetLayoutMode(NodeHandle node) const {
+	const auto& node_container = containers[container[node]];
+	if (node_container.grid == null_handle) {
+		return node_container.flex;
+	}
+	return grids[node_container.grid];
+}
+
+void Klay::LayoutTree::ComputeMinSize() noexcept {
+	LayoutPhaseTimer timer{LayoutPhase::MinSize};
+	CountLayoutStat(LayoutCounter::MinSizeComputes, Size());
+
+	// children always come after their parent,
+	// so a reverse sweep visits children first
+	for (size_t i = Size(); i-- > 0;) {
+		const auto first = first_child[i];
+		const auto last = first + num_children[i];
+		bool percent_padding = false;
+		for (NodeHandle child = first; child < last; ++child) {
+			percent_padding |= PaddingSize{padding_size[child], padding_fraction[child]}.HasPercent();
+		}
+		percent_padding_children[i] = percent_padding;
+
+		computed_min_size[i] = MinSizeForPadding(static_cast<NodeHandle>(i), padding_size[i]);
+	}
+}
+
+Klay::PxSize Klay::LayoutTree::MinSizeForPadding(
+	NodeHandle node,
+	const PxSize& padding
+) const noexcept {
+	// summed in the same order as Element::ComputeMinSize
+	PxSize computed {0, 0};
+	const auto first = first_child[node];
+	const auto last = first + num_children[node];
+	for (NodeHandle child = first; child < last; ++child) {
+		computed += computed_min_size[child];
+	}
+	computed += padding;
+
+	for (int axis = 0; axis < 2; ++axis) {
+		computed.axes[axis] = std::max(computed.axes[axis], min_size[node].axes[axis]);
+	}
+	return computed;
+}
+
+void Klay::LayoutTree::ComputeLayout(const PxRect& rect) noexcept {
+	ComputeMinSize();
+
+	LayoutPhaseTimer timer{LayoutPhase::Layout};
+	CountLayoutStat(LayoutCounter::ElementsVisited, Size());
+
+	// parents always come before their children,
+	// so a forward sweep visits each node after its rect is assigned
+	for (size_t i = 0; i < Size(); ++i) {
+		const auto node = static_cast<NodeHandle>(i);
+		if (parent[node] == null_handle) {
+			computed_position[node] = PxPoint{rect.X(), rect.Y()};
+			computed_size[node] = PxSize{rect.Width(), rect.Height()};
+		}
+		if (container[node] == null_handle || num_children[node] == 0) {
+			continue;
+		}
+
+		// percent padding resolves against the content box of the
+		// parent, or against the rect of a root
+		auto& node_container = containers[container[node]];
+		const auto padding_basis = parent[node] == null_handle || container[parent[node]] == null_handle
+			? computed_size[node]
+			: containers[container[parent[node]]].content_size;
+		const auto content_rect = ComputeContentRect(
+			node_container.layout_options,
+			ComputedRect(node),
+			padding_basis
+		);
+		node_container.content_size = PxSize{content_rect.Width(), content_rect.Height()};
+
+		if (percent_padding_children[node]) {
+			const auto first = first_child[node];
+			const auto last = first + num_children[node];
+			for (NodeHandle child = first; child < last; ++child) {
+				const PaddingSize padding{padding_size[child], padding_fraction[child]};
+				if (padding.HasPercent()) {
+					computed_min_size[child] = MinSizeForPadding(
+						child,
+						padding.Resolve(node_container.content_size)
+					);
+				}
+			}
+		}
+		CountLayoutStat(LayoutCounter::LayoutModeCalls);
+		if (node_container.grid == null_handle) {
+			node_container.flex.ComputeLayout(*this, node, content_rect);
+		}
+		else {
+			grids[node_container.grid].ComputeLayout(*this, node, content_rect);
+		}
+	}
+}
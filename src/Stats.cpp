@@ -0,0 +1,75 @@
+#include <klay/Stats.hpp>
+
+#include <array>
+#include <atomic>
+
+namespace {
+	using namespace Klay;
+
+	constexpr auto num_counters = static_cast<size_t>(LayoutCounter::Count);
+	constexpr auto num_phases = static_cast<size_t>(LayoutPhase::Count);
+
+	std::array<std::atomic<size_t>, num_counters> counters {};
+	std::array<std::atomic<long long>, num_phases> phase_ns {};
+
+	// nesting depth of each phase on this thread
+	thread_local std::array<int, num_phases> phase_depth {};
+
+	size_t Load(LayoutCounter counter) noexcept {
+		return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds Load(LayoutPhase phase) noexcept {
+		return std::chrono::nanoseconds{
+			phase_ns[static_cast<size_t>(phase)].load(std::memory_order_relaxed)
+		};
+	}
+}
+
+Klay::LayoutStats Klay::GetLayoutStats() noexcept {
+	return LayoutStats{
+		Load(LayoutCounter::ElementsVisited),
+		Load(LayoutCounter::MinSizeComputes),
+		Load(LayoutCounter::LayoutCacheHits),
+		Load(LayoutCounter::LayoutCacheMisses),
+		Load(LayoutCounter::LayoutModeCalls),
+		Load(LayoutCounter::FlexLayoutCalls),
+		Load(LayoutCounter::GridLayoutCalls),
+		Load(LayoutCounter::GridCellProbes),
+		Load(LayoutCounter::ScratchGrowths),
+		Load(LayoutCounter::MeasureCalls),
+		Load(LayoutPhase::MinSize),
+		Load(LayoutPhase::Layout),
+	};
+}
+
+void Klay::ResetLayoutStats() noexcept {
+	for (auto& counter : counters) {
+		counter.store(0, std::memory_order_relaxed);
+	}
+	for (auto& ns : phase_ns) {
+		ns.store(0, std::memory_order_relaxed);
+	}
+}
+
+void Klay::AddLayoutStat(LayoutCounter counter, size_t n) noexcept {
+	counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+bool Klay::BeginLayoutPhase(LayoutPhase phase) noexcept {
+	return ++phase_depth[static_cast<size_t>(phase)] == 1;
+}
+
+void Klay::EndLayoutPhase(
+	LayoutPhase phase,
+	bool outermost,
+	std::chrono::nanoseconds elapsed
+) noexcept {
+	--phase_depth[static_cast<size_t>(phase)];
+	if (outermost) {
+		phase_ns[static_cast<size_t>(phase)].fetch_add(
+			elapsed.count(),
+			std::memory_order_relaxed
+		);
+	}
+}
@@ -0,0 +1,143 @@
+#include <klay/ThreadPool.hpp>
+
+#include <optional>
+
+namespace {
+	// the pool and queue of the current thread, if it is a worker
+	thread_local const Klay::ThreadPool* worker_pool = nullptr;
+	thread_local size_t worker_queue = 0;
+}
+
+size_t Klay::ThreadPool::DefaultNumThreads() noexcept {
+	const auto hardware_threads = std::thread::hardware_concurrency();
+	// the thread waiting on a task group also runs tasks
+	return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+Klay::ThreadPool::ThreadPool(size_t num_threads) {
+	queues.reserve(num_threads + 1);
+	for (size_t i = 0; i < num_threads + 1; ++i) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+
+	threads.reserve(num_threads);
+	for (size_t i = 0; i < num_threads; ++i) {
+		threads.emplace_back([this, i] { WorkerLoop(i); });
+	}
+}
+
+Klay::ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock{sleep_mutex};
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+size_t Klay::ThreadPool::HomeQueue() const noexcept {
+	return worker_pool == this ? worker_queue : queues.size() - 1;
+}
+
+void Klay::ThreadPool::Spawn(TaskGroup& group, std::function<void()> task) {
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		auto& queue = *queues[HomeQueue()];
+		std::lock_guard lock{queue.mutex};
+		queue.tasks.push_back(Task{&group, std::move(task)});
+	}
+	num_queued.fetch_add(1, std::memory_order_relaxed);
+
+	// taking the lock orders the push before a sleeping worker's recheck
+	{
+		std::lock_guard lock{sleep_mutex};
+	}
+	wake.notify_one();
+}
+
+void Klay::ThreadPool::Wait(TaskGroup& group) noexcept {
+	// the tasks of a group are usually short, so spin a little
+	// before sleeping until the group finishes or a task is queued
+	constexpr int max_spins = 64;
+
+	const auto home = HomeQueue();
+	int spins = 0;
+	while (group.pending.load(std::memory_order_acquire) > 0) {
+		if (RunOne(home)) {
+			spins = 0;
+		}
+		else if (spins < max_spins) {
+			++spins;
+			std::this_thread::yield();
+		}
+		else {
+			std::unique_lock lock{sleep_mutex};
+			wake.wait(lock, [&] {
+				return group.pending.load(std::memory_order_acquire) == 0
+					|| num_queued.load(std::memory_order_relaxed) > 0;
+			});
+		}
+	}
+}
+
+bool Klay::ThreadPool::RunOne(size_t home) noexcept {
+	std::optional<Task> task;
+
+	// newest task from our own deque
+	{
+		auto& queue = *queues[home];
+		std::lock_guard lock{queue.mutex};
+		if (!queue.tasks.empty()) {
+			task.emplace(std::move(queue.tasks.back()));
+			queue.tasks.pop_back();
+		}
+	}
+
+	// otherwise steal the oldest task of another deque
+	for (size_t i = 1; !task && i < queues.size(); ++i) {
+		auto& queue = *queues[(home + i) % queues.size()];
+		std::lock_guard lock{queue.mutex};
+		if (!queue.tasks.empty()) {
+			task.emplace(std::move(queue.tasks.front()));
+			queue.tasks.pop_front();
+		}
+	}
+
+	if (!task) {
+		return false;
+	}
+
+	num_queued.fetch_sub(1, std::memory_order_relaxed);
+	task->run();
+	if (task->group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		// the group may be gone once pending reaches 0, so only the
+		// pool is touched here. Taking the lock orders the decrement
+		// before a sleeping waiter's recheck.
+		{
+			std::lock_guard lock{sleep_mutex};
+		}
+		wake.notify_all();
+	}
+	return true;
+}
+
+void Klay::ThreadPool::WorkerLoop(size_t index) noexcept {
+	worker_pool = this;
+	worker_queue = index;
+
+	for (;;) {
+		if (RunOne(index)) {
+			continue;
+		}
+
+		std::unique_lock lock{sleep_mutex};
+		wake.wait(lock, [&] {
+			return stopping || num_queued.load(std::memory_order_relaxed) > 0;
+		});
+		if (stopping && num_queued.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,192 @@
+#include <klay/VirtualList.hpp>
+#include <klay/Element.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace {
+	constexpr size_t LowBit(size_t i) noexcept {
+		return i & (~i + 1);
+	}
+}
+
+void Klay::ExtentTree::assign(size_t count, Px extent) {
+	extents.assign(count, extent);
+	tree.assign(count + 1, 0.0);
+	// linear construction, each node passes its sum to its parent
+	for (size_t i = 1; i <= count; ++i) {
+		tree[i] += extent;
+		const auto parent = i + LowBit(i);
+		if (parent <= count) {
+			tree[parent] += tree[i];
+		}
+	}
+}
+
+void Klay::ExtentTree::resize(size_t count, Px extent) {
+	if (count < size()) {
+		extents.resize(count);
+		tree.resize(count + 1);
+		return;
+	}
+	extents.reserve(count);
+	tree.reserve(count + 1);
+	while (size() < count) {
+		push_back(extent);
+	}
+}
+
+void Klay::ExtentTree::push_back(Px extent) {
+	if (tree.empty()) {
+		tree.push_back(0.0);
+	}
+	extents.push_back(extent);
+
+	// node i sums the rows [i - lowbit(i), i), which are extent
+	// plus the nodes below i that cover [i - lowbit(i), i - 1)
+	const auto i = size();
+	double sum = extent;
+	for (size_t child = i - 1; child > i - LowBit(i); child -= LowBit(child)) {
+		sum += tree[child];
+	}
+	tree.push_back(sum);
+}
+
+void Klay::ExtentTree::set(size_t index, Px extent) noexcept {
+	const double delta = static_cast<double>(extent) - extents[index];
+	extents[index] = extent;
+	for (size_t i = index + 1; i < tree.size(); i += LowBit(i)) {
+		tree[i] += delta;
+	}
+}
+
+Klay::Px Klay::ExtentTree::offset(size_t count) const noexcept {
+	double sum = 0;
+	for (size_t i = count; i > 0; i -= LowBit(i)) {
+		sum += tree[i];
+	}
+	return static_cast<float>(sum);
+}
+
+size_t Klay::ExtentTree::find(Px offset) const noexcept {
+	if (offset < 0) {
+		return 0;
+	}
+
+	// binary lifting, finds the most rows whose sum is at most offset
+	size_t count = 0;
+	double remaining = offset;
+	for (size_t step = std::bit_floor(size()); step > 0; step >>= 1) {
+		const auto next = count + step;
+		if (next <= size() && tree[next] <= remaining) {
+			count = next;
+			remaining -= tree[next];
+		}
+	}
+	return count;
+}
+
+void Klay::VirtualListLayoutMode::SetItemCount(size_t count) {
+	extents.resize(count, estimated_extent);
+}
+
+void Klay::VirtualListLayoutMode::Materialize(
+	Element& el,
+	size_t first,
+	size_t end
+) {
+	assert(provide_item && "a virtual list needs provide_item to materialize rows");
+
+	next_children.clear();
+	for (size_t i = first; i < end; ++i) {
+		if (i >= first_index && i < end_index) {
+			next_children.push_back(std::move(el.children[i - first_index]));
+			continue;
+		}
+
+		auto child = provide_item ? provide_item(i) : nullptr;
+		if (!child) {
+			child = std::make_shared<Element>();
+		}
+		child->Reparent(el.weak_from_this());
+		next_children.push_back(std::move(child));
+	}
+
+	if (recycle_item) {
+		for (size_t i = first_index; i < end_index; ++i) {
+			auto& child = el.children[i - first_index];
+			if (child) {
+				recycle_item(i, std::move(child));
+			}
+		}
+	}
+
+	std::swap(el.children, next_children);
+	next_children.clear();
+	first_index = first;
+	end_index = end;
+}
+
+void Klay::VirtualListLayoutMode::ComputeLayout(
+	Element& el,
+	const Klay::PxRect& content_rect
+) noexcept {
+	const Axis cross_axis = CrossAxis(axis);
+	const auto& main_segment = content_rect.GetAxis(axis);
+	const auto& cross_segment = content_rect.GetAxis(cross_axis);
+
+	const Px window_start = scroll_offset - overscan;
+	const Px window_end = scroll_offset + main_segment.length + overscan;
+
+	// measuring the rows can bring more rows into the window. A row's
+	// extent only changes when it is first measured or its min size
+	// changes, so this settles within a few passes
+	for (bool measured = false;;) {
+		const auto first = std::min(extents.find(window_start), extents.size());
+		const auto end = std::min(extents.find(window_end) + 1, extents.size());
+		if (first != first_index || end != end_index) {
+			Materialize(el, first, end);
+		}
+		else if (measured) {
+			break;
+		}
+
+		bool extents_changed = false;
+		for (size_t i = first_index; i < end_index; ++i) {
+			auto& child = *el.children[i - first_index];
+			if (child.dirty_size) {
+				child.ComputeMinSize();
+			}
+			const Px extent = child.computed_min_size.GetAxis(axis);
+			if (extent != extents.get(i)) {
+				extents.set(i, extent);
+				extents_changed = true;
+			}
+		}
+		if (!extents_changed) {
+			break;
+		}
+		measured = true;
+	}
+
+	// the min size pass counted the children of the previous window.
+	// Ancestors keep their count until their next min size pass, since
+	// other subtrees may be laid out in parallel with this one
+	el.subtree_size = 1;
+	for (const auto& child : el.children) {
+		el.subtree_size += child->subtree_size;
+	}
+
+	Px offset = extents.offset(first_index);
+	for (size_t i = first_index; i < end_index; ++i) {
+		auto& child = *el.children[i - first_index];
+		const Px extent = extents.get(i);
+
+		child.computed_position.GetAxis(axis) = main_segment.start + offset - scroll_offset;
+		child.computed_position.GetAxis(cross_axis) = cross_segment.start;
+		child.computed_size.GetAxis(axis) = extent;
+		child.computed_size.GetAxis(cross_axis) = cross_segment.length;
+		offset += extent;
+	}
+}
@@ -0,0 +1,47 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+TEST_CASE("Damage list reports moved elements", DamageListChanges) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().AlignItems(Align::Stretch).Build();
+	auto left = root->AddChild(ElementBuilder{}.MinWidth(Px{20}).Build());
+	auto middle = root->AddChild(ElementBuilder{}.FlexGrow(1).Build());
+	auto right = root->AddChild(ElementBuilder{}.MinWidth(Px{20}).Build());
+
+	const auto rect = PxRect::FromXYWH(0, 0, 100, 50);
+
+	DamageList damage;
+	root->ComputeTreeLayout(rect, damage);
+	test.AssertEq(damage.changes.size(), size_t{4}, "First layout should report every element");
+	test.Assert(!damage.changes[1].old_rect, "New elements have no old rect");
+
+	// nothing changed
+	root->ComputeTreeLayout(rect, damage);
+	test.Assert(damage.Empty(), "Clean relayout reported changes");
+	test.Assert(!damage.damage_rect, "Clean relayout reported damage");
+
+	// left grows, middle shrinks, right stays put
+	left->SetMinSize(OptionalSize{Px{30}, std::nullopt});
+	root->ComputeTreeLayout(rect, damage);
+	test.AssertEq(damage.changes.size(), size_t{2}, "Expected left and middle to change");
+	test.Assert(damage.changes[0].element == left.get(), "Expected left first");
+	test.AssertEq(
+		*damage.changes[0].old_rect,
+		PxRect::FromXYWH(0, 0, 20, 50),
+		"Wrong old rect"
+	);
+	test.AssertEq(
+		damage.changes[0].new_rect,
+		PxRect::FromXYWH(0, 0, 30, 50),
+		"Wrong new rect"
+	);
+	test.Assert(damage.changes[1].element == middle.get(), "Expected middle second");
+	test.AssertEq(
+		*damage.damage_rect,
+		PxRect::FromXYWH(0, 0, 80, 50),
+		"Wrong damage rect"
+	);
+}
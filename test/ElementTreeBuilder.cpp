@@ -0,0 +1,86 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+TEST_CASE("Tree builder matches element builder", ElementTreeBuilderMatches) {
+	using namespace Klay;
+
+	ElementTreeBuilder builder;
+	builder.Reserve(6);
+	const auto root = builder.Add(ElementBuilder{}.Flex().Gap(Px{10}));
+	const auto column = builder.Add(
+		ElementBuilder{}.Flex(Axis::Vertical).FlexGrow(1),
+		root
+	);
+	const auto grid = builder.Add(ElementBuilder{}.Grid(1, 2).FlexGrow(2), root);
+	for (int i = 0; i < 2; ++i) {
+		builder.Add(ElementBuilder{}.MinSize(Px{10}, Px{20}), column);
+	}
+	builder.Add(ElementBuilder{}.ColSpan(2), grid);
+	test.AssertEq(builder.Size(), size_t{6}, "Builder has every element");
+
+	auto bulk = builder.Build();
+	test.AssertEq(builder.Size(), size_t{0}, "Build resets the builder");
+
+	auto expected = ElementBuilder{}.Flex().Gap(Px{10}).Build();
+	auto expected_column = expected->AddChild(
+		ElementBuilder{}.Flex(Axis::Vertical).FlexGrow(1).Build()
+	);
+	auto expected_grid = expected->AddChild(
+		ElementBuilder{}.Grid(1, 2).FlexGrow(2).Build()
+	);
+	for (int i = 0; i < 2; ++i) {
+		expected_column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).Build());
+	}
+	expected_grid->AddChild(ElementBuilder{}.ColSpan(2).Build());
+
+	const auto rect = PxRect::FromXYWH(0, 0, 200, 100);
+	bulk->ComputeTreeLayout(rect);
+	expected->ComputeTreeLayout(rect);
+
+	test.AssertEq(bulk->NumChildren(), size_t{2}, "Root has its children");
+	for (size_t i = 0; i < 2; ++i) {
+		const auto& child = bulk->children[i];
+		const auto& expected_child = expected->children[i];
+		test.Assert(child->parent.lock() == bulk, "Child links to its parent");
+		test.AssertEq(child->ComputedRect(), expected_child->ComputedRect(), "Child has wrong layout");
+		test.AssertEq(child->NumChildren(), expected_child->NumChildren(), "Child has wrong children");
+		test.AssertEq(child->children.capacity(), child->NumChildren(), "Children are reserved exactly");
+		for (size_t j = 0; j < child->NumChildren(); ++j) {
+			test.Assert(child->children[j]->parent.lock() == child, "Grandchild links to its parent");
+			test.AssertEq(
+				child->children[j]->ComputedRect(),
+				expected_child->children[j]->ComputedRect(),
+				"Grandchild has wrong layout"
+			);
+		}
+	}
+	test.AssertEq(bulk->subtree_size, size_t{6}, "Subtree has every element");
+}
+
+TEST_CASE("Tree builder elements outlive their root", ElementTreeBuilderLifetime) {
+	using namespace Klay;
+
+	ElementTreeBuilder builder;
+	const auto root = builder.Add(ElementBuilder{}.Flex());
+	const auto child = builder.Add(ElementBuilder{}.Flex(), root);
+	builder.Add(ElementBuilder{}.MinSize(Px{10}, Px{10}), child);
+
+	auto bulk = builder.Build();
+	auto kept = bulk->children[0];
+	bulk.reset();
+
+	test.Assert(kept->parent.expired(), "Parent is destroyed");
+	test.Assert(kept->shared_from_this() == kept, "Elements are owned by shared pointers");
+
+	// elements from the block can be mixed with other elements
+	auto other = ElementBuilder{}.Flex().Build();
+	other->AddChild(kept);
+	other->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 50));
+	test.AssertEq(
+		kept->children[0]->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 10, 10),
+		"Moved subtree is laid out"
+	);
+}
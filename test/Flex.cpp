@@ -294,4 +294,331 @@ TEST_CASE("Nested Flex", NestedFlex){
 		PxRect::FromXYWH(50, 45, 50, 55),
 		"Child 4 has wrong layout"
 	);
-}
\ No newline at end of file
+}
+TEST_CASE("Flex wrap", FlexWrapLines) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}
+		.Flex()
+		.Wrap()
+		.MainGap(Px{10})
+		.CrossGap(Px{4})
+		.Build();
+
+	auto child1 = element->AddChild(ElementBuilder{}.MinWidth(Px{30}).MinHeight(Px{10}).Build());
+	auto child2 = element->AddChild(ElementBuilder{}.MinWidth(Px{40}).MinHeight(Px{20}).Build());
+	auto child3 = element->AddChild(ElementBuilder{}.MinWidth(Px{50}).MinHeight(Px{15}).Build());
+	auto child4 = element->AddChild(ElementBuilder{}.FlexGrow(1).MinWidth(Px{20}).MinHeight(Px{5}).Build());
+
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(child1->ComputedRect(), PxRect::FromXYWH(0, 0, 30, 10), "Child 1 has wrong layout");
+	test.AssertEq(child2->ComputedRect(), PxRect::FromXYWH(40, 0, 40, 20), "Child 2 has wrong layout");
+	test.AssertEq(child3->ComputedRect(), PxRect::FromXYWH(0, 24, 50, 15), "Child 3 has wrong layout");
+	// grows into the rest of its own line only
+	test.AssertEq(child4->ComputedRect(), PxRect::FromXYWH(60, 24, 40, 5), "Child 4 has wrong layout");
+
+	const auto& flex = *element->layout_mode.GetIf<FlexLayoutMode>();
+	test.AssertEq(flex.GetLines().size(), size_t{2}, "Wrong number of lines");
+}
+
+TEST_CASE("Appending to a wrapped flex only lays out the last line", FlexWrapAppend) {
+	using namespace Klay;
+
+	const auto build_item = [](int i) {
+		return ElementBuilder{}
+			.MinWidth(Px{static_cast<float>(10 + i % 4 * 5)})
+			.MinHeight(Px{static_cast<float>(5 + i % 3)})
+			.FlexGrow(static_cast<float>(i % 2))
+			.Build();
+	};
+	const auto rect = PxRect::FromXYWH(0, 0, 100, 1000);
+
+	auto element = ElementBuilder{}.Flex().Wrap().MainGap(Px{2}).CrossGap(Px{3}).Build();
+	for (int i = 0; i < 40; ++i) {
+		element->AddChild(build_item(i));
+	}
+	element->ComputeTreeLayout(rect);
+
+	const auto& flex = *element->layout_mode.GetIf<FlexLayoutMode>();
+	const auto num_lines = flex.GetLines().size();
+	const auto last_line_start = flex.GetLines().back().start;
+	test.Assert(num_lines > 2, "Items should wrap onto several lines");
+
+	// only visible if the first line is laid out again
+	const auto first_rect = element->children[0]->ComputedRect();
+	element->children[0]->computed_position = PxPoint{-1, -1};
+
+	for (int i = 40; i < 43; ++i) {
+		element->AddChild(build_item(i));
+	}
+	element->ComputeTreeLayout(rect);
+
+	test.AssertEq(
+		element->children[0]->computed_position,
+		PxPoint{-1, -1},
+		"First line was laid out again"
+	);
+	test.Assert(flex.GetLines().size() >= num_lines, "Lines were lost");
+	test.AssertEq(
+		flex.GetLines()[num_lines - 1].start,
+		last_line_start,
+		"Last line moved"
+	);
+
+	// otherwise matches a layout from scratch
+	auto fresh = ElementBuilder{}.Flex().Wrap().MainGap(Px{2}).CrossGap(Px{3}).Build();
+	for (int i = 0; i < 43; ++i) {
+		fresh->AddChild(build_item(i));
+	}
+	fresh->ComputeTreeLayout(rect);
+
+	test.AssertEq(fresh->children[0]->ComputedRect(), first_rect, "First item differs");
+	for (size_t i = 1; i < fresh->children.size(); ++i) {
+		test.AssertEq(
+			element->children[i]->ComputedRect(),
+			fresh->children[i]->ComputedRect(),
+			"Incremental wrap differs from a full layout"
+		);
+	}
+}
+
+TEST_CASE("Wrapped flex lines are broken again when children move", FlexWrapRemove) {
+	using namespace Klay;
+
+	const auto build_item = [](int i) {
+		return ElementBuilder{}
+			.MinWidth(Px{static_cast<float>(10 + i % 4 * 5)})
+			.MinHeight(Px{static_cast<float>(5 + i % 3)})
+			.Build();
+	};
+	const auto rect = PxRect::FromXYWH(0, 0, 100, 1000);
+
+	auto element = ElementBuilder{}.Flex().Wrap().MainGap(Px{2}).Build();
+	for (int i = 0; i < 40; ++i) {
+		element->AddChild(build_item(i));
+	}
+	element->ComputeTreeLayout(rect);
+
+	// the remaining children stay clean, only the parent is marked
+	element->children.erase(element->children.begin() + 1);
+	std::swap(element->children[10], element->children[20]);
+	element->MarkDirty();
+	element->ComputeTreeLayout(rect);
+
+	auto fresh = ElementBuilder{}.Flex().Wrap().MainGap(Px{2}).Build();
+	for (const auto& child : element->children) {
+		const auto& min_size = child->computed_min_size;
+		fresh->AddChild(ElementBuilder{}.MinSize(min_size.Horizontal(), min_size.Vertical()).Build());
+	}
+	fresh->ComputeTreeLayout(rect);
+
+	const auto& lines = element->layout_mode.GetIf<FlexLayoutMode>()->GetLines();
+	const auto& fresh_lines = fresh->layout_mode.GetIf<FlexLayoutMode>()->GetLines();
+	test.AssertEq(lines.size(), fresh_lines.size(), "Wrong number of lines");
+	for (size_t i = 0; i < element->children.size(); ++i) {
+		test.AssertEq(
+			element->children[i]->ComputedRect(),
+			fresh->children[i]->ComputedRect(),
+			"Stale lines were reused"
+		);
+	}
+}
+
+TEST_CASE("Flex shrink", FlexShrink) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().Build();
+	auto child1 = element->AddChild(ElementBuilder{}.Width(Px{100}).FlexShrink(1).Build());
+	auto child2 = element->AddChild(ElementBuilder{}.Width(Px{200}).FlexShrink(1).Build());
+	auto child3 = element->AddChild(ElementBuilder{}.MinWidth(Px{50}).FlexGrow(1).Build());
+
+	// 150px too many, taken in proportion to shrink times preferred width
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 200, 10));
+
+	test.AssertEq(child1->ComputedRect(), PxRect::FromXYWH(0, 0, 50, 0), "Child 1 has wrong layout");
+	test.AssertEq(child2->ComputedRect(), PxRect::FromXYWH(50, 0, 100, 0), "Child 2 has wrong layout");
+	// grow does not apply to negative free space
+	test.AssertEq(child3->ComputedRect(), PxRect::FromXYWH(150, 0, 50, 0), "Child 3 has wrong layout");
+}
+
+TEST_CASE("Flex shrink freezes items at their min size", FlexShrinkFreeze) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().Build();
+	auto child1 = element->AddChild(ElementBuilder{}.Width(Px{10}).FlexShrink(10).Build());
+	auto child2 = element->AddChild(ElementBuilder{}.Width(Px{100}).FlexShrink(1).Build());
+
+	// child 1 would be asked for 25px, so it stops at 0
+	// and child 2 takes the other 40px
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 60, 10));
+
+	test.AssertEq(child1->ComputedRect(), PxRect::FromXYWH(0, 0, 0, 0), "Child 1 has wrong layout");
+	test.AssertEq(child2->ComputedRect(), PxRect::FromXYWH(0, 0, 60, 0), "Child 2 has wrong layout");
+
+	// with every item at its min size the rest overflows
+	auto child3 = element->AddChild(ElementBuilder{}.MinWidth(Px{30}).Build());
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 10, 10));
+
+	test.AssertEq(child1->computed_size.Horizontal(), Px{0}, "Child 1 should be frozen at zero");
+	test.AssertEq(child2->computed_size.Horizontal(), Px{0}, "Child 2 should be frozen at zero");
+	test.AssertEq(child3->ComputedRect(), PxRect::FromXYWH(0, 0, 30, 0), "Items without shrink keep their size");
+
+	// an item never shrinks below its min size
+	auto row = ElementBuilder{}.Flex().Build();
+	auto floored = row->AddChild(ElementBuilder{}.MinWidth(Px{100}).Width(Px{200}).FlexShrink(1).Build());
+	row->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 10));
+	test.AssertEq(floored->computed_size.Horizontal(), Px{100}, "Item shrank below its min size");
+
+	// 64px too many, about 39px each, so the first stops at its min
+	// and the second takes the other 44px
+	auto first = ElementBuilder{}.MinWidth(Px{80}).Width(Px{100}).FlexShrink(1).Build();
+	auto second = ElementBuilder{}.Width(Px{64}).FlexShrink(1).Build();
+	row = ElementBuilder{}.Flex().Build();
+	row->AddChild(first);
+	row->AddChild(second);
+	row->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 10));
+	test.AssertEq(first->ComputedRect(), PxRect::FromXYWH(0, 0, 80, 0), "First item should stop at its min");
+	test.AssertEq(second->ComputedRect(), PxRect::FromXYWH(80, 0, 20, 0), "Second item has wrong layout");
+}
+
+TEST_CASE("Long shrinking lines fill the container", FlexShrinkLongLine) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().MainGap(Px{1}).Build();
+	for (int i = 0; i < 2000; ++i) {
+		element->AddChild(
+			ElementBuilder{}
+				.Width(Px{static_cast<float>(4 + i % 9)})
+				.MinWidth(Px{static_cast<float>(i % 3)})
+				.FlexShrink(static_cast<float>(i % 5) * 0.5f)
+				.Build()
+		);
+	}
+	const auto rect = PxRect::FromXYWH(0, 0, 9000, 10);
+	element->ComputeTreeLayout(rect);
+
+	Px total;
+	for (const auto& child : element->children) {
+		test.Assert(child->computed_size.Horizontal() >= child->layout_min_size.Horizontal(), "Item shrank below its min size");
+		total += child->computed_size.Horizontal();
+	}
+	total += Px{1999};
+	test.Assert(
+		total.value > 8999.0f && total.value < 9001.0f,
+		"Items should exactly fill the line"
+	);
+
+	auto tree = LayoutTree::FromElement(*element);
+	tree.ComputeLayout(rect);
+	for (size_t i = 0; i < element->children.size(); ++i) {
+		test.AssertEq(
+			tree.ComputedRect(static_cast<NodeHandle>(i + 1)),
+			element->children[i]->ComputedRect(),
+			"LayoutTree differs from Element"
+		);
+	}
+}
+
+TEST_CASE("Items with the default shrink overflow the line", FlexOverflow) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().Build();
+	auto child1 = element->AddChild(ElementBuilder{}.MinWidth(Px{60}).FlexGrow(1).Build());
+	auto child2 = element->AddChild(ElementBuilder{}.MinWidth(Px{60}).Build());
+
+	// 20px too many, and neither item shrinks, so they keep their
+	// min sizes, and the negative free space is not grown into
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 10));
+
+	test.AssertEq(child1->ComputedRect(), PxRect::FromXYWH(0, 0, 60, 0), "Child 1 should keep its min size");
+	test.AssertEq(child2->ComputedRect(), PxRect::FromXYWH(60, 0, 60, 0), "Child 2 should overflow the line");
+}
+
+TEST_CASE("Flex grow stops at max sizes", FlexMaxSize) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().AlignItems(Align::Stretch).Build();
+	auto capped = element->AddChild(ElementBuilder{}.FlexGrow(1).MaxSize(Px{50}, Px{20}).Build());
+	auto free = element->AddChild(ElementBuilder{}.FlexGrow(1).Build());
+	auto preferred = element->AddChild(ElementBuilder{}.Width(Px{40}).FlexGrow(2).MaxWidth(Px{100}).Build());
+
+	// 260px of free space: 65, 65 and 130 before the max sizes, then
+	// the capped items give their leftover to the free one
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 300, 40));
+
+	test.AssertEq(capped->ComputedRect(), PxRect::FromXYWH(0, 0, 50, 20), "Capped item has wrong layout");
+	test.AssertEq(free->ComputedRect(), PxRect::FromXYWH(50, 0, 150, 40), "Free item has wrong layout");
+	test.AssertEq(preferred->ComputedRect(), PxRect::FromXYWH(200, 0, 100, 40), "Preferred item has wrong layout");
+
+	// with every growing item at its max, the rest is justified
+	free->SetMaxSize(OptionalSize{Px{30}, std::nullopt});
+	element->layout_options.justify_content = Justify::End;
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 300, 40));
+
+	test.AssertEq(capped->ComputedRect(), PxRect::FromXYWH(120, 0, 50, 20), "Capped item has wrong layout");
+	test.AssertEq(free->ComputedRect(), PxRect::FromXYWH(170, 0, 30, 40), "Free item has wrong layout");
+	test.AssertEq(preferred->ComputedRect(), PxRect::FromXYWH(200, 0, 100, 40), "Preferred item has wrong layout");
+}
+
+TEST_CASE("Flex items start from their preferred size", FlexPreferredSize) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().Wrap().Build();
+	auto child1 = element->AddChild(ElementBuilder{}.PreferredSize(Px{60}, Px{10}).Build());
+	auto child2 = element->AddChild(ElementBuilder{}.Width(Px{60}).MinWidth(Px{70}).Build());
+	auto child3 = element->AddChild(ElementBuilder{}.Width(Px{60}).MaxWidth(Px{20}).MinHeight(Px{5}).Build());
+
+	// preferred sizes also decide where lines break
+	element->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(child1->ComputedRect(), PxRect::FromXYWH(0, 0, 60, 10), "Child 1 has wrong layout");
+	test.AssertEq(child2->ComputedRect(), PxRect::FromXYWH(0, 10, 70, 0), "Min size should win over preferred");
+	test.AssertEq(child3->ComputedRect(), PxRect::FromXYWH(70, 10, 20, 5), "Max size should win over preferred");
+}
+
+TEST_CASE("Long lines with max sizes match LayoutTree", FlexMaxSizeLongLine) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.Flex().MainGap(Px{1}).Build();
+	for (int i = 0; i < 1000; ++i) {
+		ElementBuilder builder;
+		builder
+			.MinWidth(Px{static_cast<float>(2 + i % 5)})
+			.FlexGrow(static_cast<float>(1 + i % 3));
+		if (i % 4 != 0) {
+			builder.MaxWidth(Px{static_cast<float>(4 + i % 11)});
+		}
+		element->AddChild(builder.Build());
+	}
+	const auto rect = PxRect::FromXYWH(0, 0, 9000, 10);
+	element->ComputeTreeLayout(rect);
+
+	Px total;
+	for (const auto& child : element->children) {
+		const auto max = child->size.max.Horizontal();
+		if (max) {
+			// min sizes win over max sizes
+			test.Assert(
+				child->computed_size.Horizontal() <= std::max(max->Get<Px>(), child->computed_min_size.Horizontal()),
+				"Item grew past its max size"
+			);
+		}
+		total += child->computed_size.Horizontal();
+	}
+	total += Px{999};
+	test.Assert(
+		total.value > 8999.0f && total.value < 9001.0f,
+		"Items should exactly fill the line"
+	);
+
+	auto tree = LayoutTree::FromElement(*element);
+	tree.ComputeLayout(rect);
+	for (size_t i = 0; i < element->children.size(); ++i) {
+		test.AssertEq(
+			tree.ComputedRect(static_cast<NodeHandle>(i + 1)),
+			element->children[i]->ComputedRect(),
+			"LayoutTree differs from Element"
+		);
+	}
+}
@@ -0,0 +1,171 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+using namespace KTest;
+
+namespace {
+	using namespace Klay;
+
+	// a row of items with fractional sizes, so that any change in the
+	// order of the additions shows up in the results
+	std::shared_ptr<Element> MakeRow(size_t count, Justify justify, bool grow, bool shrink) {
+		auto root = ElementBuilder{}
+			.Flex()
+			.JustifyContent(justify)
+			.AlignItems(Align::Center)
+			.MainGap(Px{0.37f})
+			.Build();
+		for (size_t i = 0; i < count; ++i) {
+			ElementBuilder child;
+			child
+				.MinSize(Px{1.1f + (i * 7 % 13) * 0.31f}, Px{3.7f + (i % 5) * 1.9f})
+				.FlexGrow(grow ? static_cast<float>(i % 4) * 0.7f : 0.0f)
+				.FlexShrink(shrink ? 1.0f : 0.0f);
+			if (i % 3 == 0) {
+				child.AlignSelf(static_cast<Align>(i / 3 % 4));
+			}
+			root->AddChild(child.Build());
+		}
+		return root;
+	}
+
+	// the children of a row laid out by ComputeFlexLine into
+	// separate arrays, as a reference for the kernels
+	struct ReferenceItems {
+		const Element& row;
+		std::vector<PxSize>& sizes;
+		std::vector<PxPoint>& positions;
+
+		size_t Size() const noexcept {
+			return row.children.size();
+		}
+
+		PxSize MinSize(size_t i) const noexcept {
+			return row.children[i]->layout_min_size;
+		}
+
+		PxSize PreferredSize(size_t i) const noexcept {
+			return MinSize(i);
+		}
+
+		PxSize MaxSize(size_t) const noexcept {
+			return unbounded_size;
+		}
+
+		float Grow(size_t i) const noexcept {
+			return row.children[i]->item_options.grow;
+		}
+
+		float Shrink(size_t i) const noexcept {
+			return row.children[i]->item_options.shrink;
+		}
+
+		std::optional<Align> AlignSelf(size_t i) const noexcept {
+			return row.children[i]->item_options.align_self;
+		}
+
+		PxSize& ComputedSize(size_t i) const noexcept {
+			return sizes[i];
+		}
+
+		PxPoint& ComputedPosition(size_t i) const noexcept {
+			return positions[i];
+		}
+	};
+
+	std::vector<PxRect> ReferenceLayout(const Element& row, const PxRect& contentRect) {
+		std::vector<PxSize> sizes(row.children.size());
+		std::vector<PxPoint> positions(row.children.size());
+		const auto& flex = *row.layout_mode.GetIf<FlexLayoutMode>();
+		ComputeFlexLine(flex.main_axis, row.layout_options, contentRect, ReferenceItems{row, sizes, positions});
+
+		std::vector<PxRect> rects;
+		for (size_t i = 0; i < sizes.size(); ++i) {
+			rects.push_back(PxRect{
+				Segment{positions[i].Horizontal(), sizes[i].Horizontal()},
+				Segment{positions[i].Vertical(), sizes[i].Vertical()},
+			});
+		}
+		return rects;
+	}
+
+	bool SameBits(const PxRect& a, const PxRect& b) {
+		return std::memcmp(&a, &b, sizeof(PxRect)) == 0;
+	}
+
+	constexpr size_t static_count = 41;
+
+	constexpr auto MakeStaticRow() {
+		std::array<StaticElement, static_count + 1> elements {};
+		elements[0].layout = StaticLayoutKind::Flex;
+		elements[0].layout_options.main_gap = Px{0.37f};
+		elements[0].layout_options.justify_content = Justify::SpaceBetween;
+		for (size_t i = 1; i <= static_count; ++i) {
+			elements[i].parent = 0;
+			elements[i].min_size = PxSize{1.1f + (i * 7 % 13) * 0.31f, 3.7f + (i % 5) * 1.9f};
+			if (i % 3 == 0) {
+				elements[i].align_self = static_cast<Align>(i / 3 % 4);
+			}
+		}
+		return elements;
+	}
+
+	constexpr auto static_viewport = PxRect::FromXYWH(0.5f, 0.25f, 301.3f, 40.1f);
+	constexpr StaticLayout static_row {MakeStaticRow(), static_viewport};
+}
+
+TEST_CASE("Flex kernels are bit-exact with ComputeFlexLine", FlexKernelBitExact) {
+	using namespace Klay;
+
+	const auto original = GetFlexKernelIsa();
+
+	// rows short enough to fall back to ComputeFlexLine, rows long
+	// enough to run the kernels, and rows that overflow and shrink
+	for (size_t count : {1, 7, 31, 32, 33, 64, 203}) {
+		for (auto justify : {Justify::Start, Justify::Center, Justify::SpaceBetween, Justify::SpaceEvenly}) {
+			for (bool grow : {false, true}) {
+				for (bool shrink : {false, true}) {
+					const auto rect = PxRect::FromXYWH(0.5f, 0.25f, shrink ? 40.3f : 301.3f, 40.1f);
+
+					auto root = MakeRow(count, justify, grow, shrink);
+					root->ComputeLayout(rect);
+					const auto reference = ReferenceLayout(*root, rect);
+					auto tree = LayoutTree::FromElement(*root);
+
+					// elements and tree nodes both run the kernels
+					for (auto isa : {FlexKernelIsa::Scalar, FlexKernelIsa::SSE2, FlexKernelIsa::AVX2, FlexKernelIsa::NEON}) {
+						if (!SetFlexKernelIsa(isa)) {
+							continue;
+						}
+						root->ComputeLayout(rect);
+						tree.ComputeLayout(rect);
+						for (size_t i = 0; i < count; ++i) {
+							test.Assert(
+								SameBits(root->children[i]->ComputedRect(), reference[i]),
+								"Element kernel result differs from ComputeFlexLine"
+							);
+							test.Assert(
+								SameBits(tree.ComputedRect(static_cast<NodeHandle>(i + 1)), reference[i]),
+								"Tree kernel result differs from ComputeFlexLine"
+							);
+						}
+					}
+				}
+			}
+		}
+	}
+	SetFlexKernelIsa(original);
+}
+
+TEST_CASE("Flex lines laid out at runtime are bit-exact with compile time", FlexKernelMatchesConstexpr) {
+	using namespace Klay;
+
+	// a runtime call, against rects computed by the compiler
+	const auto rects = ComputeStaticLayout(static_row.elements, static_viewport);
+	for (size_t i = 0; i < rects.size(); ++i) {
+		test.Assert(SameBits(rects[i], static_row.rects[i]), "Runtime result differs from compile time");
+	}
+}
@@ -5,6 +5,8 @@
 #include <klay/ElementBuilder.hpp>
 #include <klay/ToString.hpp>
 
+#include <array>
+
 TEST_CASE("Grid Data Structure", GridDataStructure) {
 	using namespace Klay;
 
@@ -152,9 +154,7 @@ TEST_CASE("Grid Gap", GridGap) {
 		.Gap(Px{10}, Px{20})
 		.Build();
 
-	const auto& layout_mode = static_cast<const GridLayoutMode*>(
-		root->layout_mode.get()
-	);
+	const auto* layout_mode = root->layout_mode.GetIf<GridLayoutMode>();
 
 	auto child1 = root->AddChild(
 		ElementBuilder{}
@@ -313,3 +313,197 @@ TEST_CASE("Grid repeat to track list", GridRepeatToTrackList) {
 		);
 	}
 }
+
+TEST_CASE("Occupancy grid spans", OccupancyGridSpans) {
+	using namespace Klay;
+
+	OccupancyGrid grid { 2, 100 };
+
+	test.Assert(grid.is_free(0, 2, 0, 100), "New grid is free");
+
+	// straddles the first word boundary
+	grid.mark(0, 1, 60, 8);
+
+	test.Assert(grid.get_cell(0, 60), "First marked cell is occupied");
+	test.Assert(grid.get_cell(0, 67), "Last marked cell is occupied");
+	test.Assert(!grid.get_cell(0, 59), "Cell before span is free");
+	test.Assert(!grid.get_cell(0, 68), "Cell after span is free");
+	test.Assert(!grid.get_cell(1, 64), "Other row is free");
+	test.Assert(!grid.is_free(0, 1, 66, 10), "Overlapping span is not free");
+	test.Assert(grid.is_free(1, 1, 0, 100), "Other row is still free");
+	test.Assert(grid.is_free(0, 1, 100, 10), "Cells outside the grid are free");
+
+	test.AssertEq(grid.find_free(0, 1, 0, 60), 0, "Run before span");
+	test.AssertEq(grid.find_free(0, 1, 10, 60), 68, "Run after span");
+	test.AssertEq(grid.find_free(0, 2, 10, 60, 100), int{OccupancyGrid::no_column}, "Run past limit");
+	test.AssertEq(grid.find_free(1, 1, 10, 60, 100), 10, "Run in free row");
+
+	// grows the grid, keeping the marked cells
+	grid.mark(3, 1, 130, 2);
+
+	test.AssertEq(grid.num_rows, 4, "Grid grows rows");
+	test.AssertEq(grid.num_cols, 132, "Grid grows columns");
+	test.Assert(grid.get_cell(0, 64), "Marked cell survives resize");
+	test.Assert(grid.get_cell(3, 131), "New cell is marked");
+
+	grid.reset(2, 2);
+
+	test.Assert(!grid.get_cell(0, 64), "Reset frees every cell");
+	test.AssertEq(grid.num_cols, 2, "Reset sets the size");
+}
+
+TEST_CASE("Multi-span Auto Positioning", MultiSpanAutoPositioning){
+	using namespace Klay;
+
+	auto root = ElementBuilder{}
+		.Grid(2, 100)
+		.Build();
+
+	auto blocker = root->AddChild(
+		ElementBuilder{}.Row(0).Col(60, 4).Build()
+	);
+
+	std::vector<std::shared_ptr<Element>> spans;
+	for (int i = 0; i < 4; ++i) {
+		spans.push_back(root->AddChild(ElementBuilder{}.ColSpan(30).Build()));
+	}
+
+	root->ComputeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(
+		blocker->ComputedRect(),
+		PxRect::FromXYWH(60, 0, 4, 50),
+		"Blocker position wrong"
+	);
+
+	const std::array<PxRect, 4> expected {
+		PxRect::FromXYWH(0, 0, 30, 50),
+		PxRect::FromXYWH(30, 0, 30, 50),
+		// skips past the blocker
+		PxRect::FromXYWH(64, 0, 30, 50),
+		// no room left in the row
+		PxRect::FromXYWH(0, 50, 30, 50),
+	};
+	for (size_t i = 0; i < spans.size(); ++i) {
+		test.AssertEq(
+			spans[i]->ComputedRect(),
+			expected[i],
+			"Span position wrong"
+		);
+	}
+}
+
+TEST_CASE("Grid relayout reuses scratch state", GridRelayoutScratch){
+	using namespace Klay;
+
+	auto root = ElementBuilder{}
+		.Grid(2, 2)
+		.Build();
+
+	auto child1 = root->AddChild(ElementBuilder{}.Build());
+	auto child2 = root->AddChild(ElementBuilder{}.Build());
+
+	// fill a bigger implicit grid first
+	root->AddChild(ElementBuilder{}.Row(1).Col(0, 6).Build());
+	root->ComputeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(
+		root->layout_mode.GetIf<GridLayoutMode>()->GetImplicitGridSize(),
+		Vector2<int>{2, 6},
+		"Implicit grid grows for the wide item"
+	);
+
+	// the cells of the removed item must not stay occupied
+	root->children.pop_back();
+	auto item_options = child1->item_options;
+	item_options.row_start = 1;
+	item_options.col_start = 1;
+	child1->SetItemOptions(item_options);
+	root->ComputeLayout(PxRect::FromXYWH(0, 0, 200, 200));
+
+	test.AssertEq(
+		root->layout_mode.GetIf<GridLayoutMode>()->GetImplicitGridSize(),
+		Vector2<int>{2, 2},
+		"Implicit grid is reset between layouts"
+	);
+	test.AssertEq(
+		child1->ComputedRect(),
+		PxRect::FromXYWH(100, 100, 100, 100),
+		"Child 1 position wrong"
+	);
+	test.AssertEq(
+		child2->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 100, 100),
+		"Child 2 position wrong"
+	);
+}
+
+TEST_CASE("Grid track sizing", GridTrackSizing) {
+	using namespace Klay;
+
+	// columns: 100px, 25%, 1fr, 3fr over 400px with 10px gaps
+	// leaves 400 - 100 - 100 - 30 = 170px, so 1fr = 42.5px
+	// rows: 50px, then implicit rows at 1fr of the remaining 50px
+	auto root = ElementBuilder{}
+		.ColumnTracks(GridTrackList{Px{100}, Percent{0.25f}, GridFr{1}, GridFr{3}})
+		.RowTracks(GridTrackList{Px{50}, GridFr{1}})
+		.Gap(Px{10}, Px{0})
+		.Build();
+
+	auto fixed = root->AddChild(ElementBuilder{}.Row(0).Col(0).Build());
+	auto percent = root->AddChild(ElementBuilder{}.Row(0).Col(1).Build());
+	auto spanning = root->AddChild(ElementBuilder{}.Row(0).Col(2, 2).Build());
+	auto fr = root->AddChild(ElementBuilder{}.Row(1).Col(3).Build());
+	auto all = root->AddChild(ElementBuilder{}.Row(2).Col(0, 4).Build());
+
+	root->ComputeLayout(PxRect::FromXYWH(0, 0, 400, 100));
+
+	const auto* layout_mode = root->layout_mode.GetIf<GridLayoutMode>();
+	test.AssertEq(
+		layout_mode->GetExplicitGridSize(),
+		Vector2<int>{2, 4},
+		"Explicit grid size comes from the track lists"
+	);
+
+	test.AssertEq(fixed->ComputedRect(), PxRect::FromXYWH(0, 0, 100, 50), "Fixed track wrong");
+	test.AssertEq(percent->ComputedRect(), PxRect::FromXYWH(110, 0, 100, 50), "Percent track wrong");
+	test.AssertEq(
+		spanning->ComputedRect(),
+		PxRect::FromXYWH(220, 0, 42.5f + 10 + 127.5f, 50),
+		"Spanning fr tracks wrong"
+	);
+	test.AssertEq(fr->ComputedRect(), PxRect::FromXYWH(272.5f, 50, 127.5f, 50), "Fr track wrong");
+	test.AssertEq(all->ComputedRect(), PxRect::FromXYWH(0, 100, 400, 50), "Implicit row wrong");
+}
+
+TEST_CASE("Grid items are clamped within their area", GridItemSizeLimits) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Grid(2, 2).Build();
+	auto capped = root->AddChild(ElementBuilder{}.Row(0).Col(0).MaxSize(Px{30}, Px{60}).Build());
+	auto preferred = root->AddChild(ElementBuilder{}.Row(0).Col(1).PreferredSize(Px{20}, Px{80}).Build());
+	auto raised = root->AddChild(ElementBuilder{}.Row(1).Col(0).Width(Px{10}).MinWidth(Px{15}).Build());
+	auto filled = root->AddChild(ElementBuilder{}.Row(1).Col(1).Build());
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(capped->ComputedRect(), PxRect::FromXYWH(0, 0, 30, 50), "Max size should cap the item");
+	test.AssertEq(preferred->ComputedRect(), PxRect::FromXYWH(50, 0, 20, 50), "Preferred size should stay in the area");
+	test.AssertEq(raised->ComputedRect(), PxRect::FromXYWH(0, 50, 15, 50), "Min size should win over preferred");
+	test.AssertEq(filled->ComputedRect(), PxRect::FromXYWH(50, 50, 50, 50), "Items without sizes fill their area");
+
+	// a preferred size of 0 is kept, the other axis still fills
+	capped->SetPreferredSize({Px{0}, std::nullopt});
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.AssertEq(capped->ComputedRect(), PxRect::FromXYWH(0, 0, 0, 50), "Preferred size of 0 should be kept");
+
+	auto tree = LayoutTree::FromElement(*root);
+	tree.ComputeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	for (NodeHandle node = 1; node < tree.Size(); ++node) {
+		test.AssertEq(
+			tree.ComputedRect(node),
+			root->children[node - 1]->ComputedRect(),
+			"LayoutTree differs from Element"
+		);
+	}
+}
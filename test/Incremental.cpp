@@ -0,0 +1,200 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+namespace {
+	// flex layout mode that counts how many times it was run
+	struct CountingFlexLayoutMode : Klay::FlexLayoutMode {
+		int* count;
+
+		CountingFlexLayoutMode(int* count, Klay::Axis axis = Klay::Axis::Horizontal)
+			: Klay::FlexLayoutMode{axis}, count{count}
+		{}
+
+		void ComputeLayout(
+			Klay::Element& el,
+			const Klay::PxRect& content_rect
+		) noexcept override {
+			++*count;
+			Klay::FlexLayoutMode::ComputeLayout(el, content_rect);
+		}
+	};
+}
+
+TEST_CASE("Tree layout recurses into children", TreeLayoutRecurses) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().AlignItems(Align::Stretch).Build();
+	auto column = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.Flex(Axis::Vertical)
+			.AlignItems(Align::Stretch)
+			.Build()
+	);
+	auto child1 = column->AddChild(
+		ElementBuilder{}.FlexGrow(1).MinHeight(Px{20}).Build()
+	);
+	auto child2 = column->AddChild(
+		ElementBuilder{}.MinHeight(Px{20}).Build()
+	);
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(
+		column->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 100, 100),
+		"Column has wrong layout"
+	);
+	test.AssertEq(
+		child1->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 100, 80),
+		"Child 1 has wrong layout"
+	);
+	test.AssertEq(
+		child2->ComputedRect(),
+		PxRect::FromXYWH(0, 80, 100, 20),
+		"Child 2 has wrong layout"
+	);
+}
+
+TEST_CASE("Tree layout only visits dirty subtrees", TreeLayoutSkipsClean) {
+	using namespace Klay;
+
+	int root_count = 0;
+	int left_count = 0;
+	int right_count = 0;
+
+	auto root = ElementBuilder{}
+		.LayoutMode(std::make_unique<CountingFlexLayoutMode>(&root_count))
+		.AlignItems(Align::Stretch)
+		.Build();
+	auto left = root->AddChild(
+		ElementBuilder{}
+			.LayoutMode(std::make_unique<CountingFlexLayoutMode>(&left_count))
+			.Build()
+	);
+	auto right = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.LayoutMode(std::make_unique<CountingFlexLayoutMode>(&right_count))
+			.Build()
+	);
+	auto label = left->AddChild(
+		ElementBuilder{}.MinSize(Px{10}, Px{10}).Build()
+	);
+	right->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{10}).Build());
+
+	const auto rect = PxRect::FromXYWH(0, 0, 100, 100);
+	root->ComputeTreeLayout(rect);
+
+	test.AssertEq(root_count, 1, "Root is laid out once");
+	test.AssertEq(left_count, 1, "Left is laid out once");
+	test.AssertEq(right_count, 1, "Right is laid out once");
+
+	// nothing changed, nothing is laid out
+	root->ComputeTreeLayout(rect);
+
+	test.AssertEq(root_count, 1, "Clean root is skipped");
+	test.AssertEq(left_count, 1, "Clean left is skipped");
+	test.AssertEq(right_count, 1, "Clean right is skipped");
+
+	// label grows, so left grows and right moves
+	label->SetMinSize({Px{20}, Px{10}});
+	test.Assert(left->dirty_size, "Dirty size propagates to parent");
+	test.Assert(root->dirty_size, "Dirty size propagates to root");
+	test.Assert(!right->dirty_size, "Dirty size does not propagate to siblings");
+
+	root->ComputeTreeLayout(rect);
+
+	test.AssertEq(root_count, 2, "Dirty root is laid out");
+	test.AssertEq(left_count, 2, "Dirty left is laid out");
+	test.AssertEq(right_count, 2, "Right is laid out since its rect changed");
+	test.AssertEq(
+		label->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 20, 10),
+		"Label has wrong layout"
+	);
+	test.AssertEq(
+		right->ComputedRect(),
+		PxRect::FromXYWH(20, 0, 80, 100),
+		"Right has wrong layout"
+	);
+
+	// a change that doesn't move anything outside of left
+	// leaves right alone
+	left->SetItemOptions(left->item_options);
+	root->ComputeTreeLayout(rect);
+
+	test.AssertEq(left_count, 3, "Dirty left is laid out");
+	test.AssertEq(right_count, 2, "Right is skipped since its rect is unchanged");
+
+	// a new rect lays out everything whose rect changed
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 200, 100));
+
+	test.AssertEq(root_count, 4, "Root is laid out with new rect");
+	test.AssertEq(left_count, 3, "Left is skipped since its rect is unchanged");
+	test.AssertEq(right_count, 3, "Right is laid out with new rect");
+}
+
+TEST_CASE("Layout cache hits on repeated inputs", LayoutCacheHits) {
+	using namespace Klay;
+
+	int root_count = 0;
+	int row_count = 0;
+
+	auto root = ElementBuilder{}
+		.LayoutMode(std::make_unique<CountingFlexLayoutMode>(&root_count))
+		.Build();
+	auto row = root->AddChild(
+		ElementBuilder{}
+			.LayoutMode(std::make_unique<CountingFlexLayoutMode>(&row_count))
+			.Build()
+	);
+	for (int i = 0; i < 3; ++i) {
+		row->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{10}).Build());
+	}
+
+	const auto rect = PxRect::FromXYWH(0, 0, 100, 100);
+
+	ResetLayoutStats();
+	root->ComputeTreeLayout(rect);
+
+	auto stats = GetLayoutStats();
+	if constexpr (layout_stats_enabled) {
+		test.AssertEq(stats.layout_cache_hits, size_t{0}, "First pass has no hits");
+		test.AssertEq(stats.layout_cache_misses, size_t{5}, "First pass misses every element");
+	}
+
+	// steady state: only the root is visited
+	ResetLayoutStats();
+	root->ComputeTreeLayout(rect);
+
+	stats = GetLayoutStats();
+	test.AssertEq(root_count, 1, "Clean root is not laid out again");
+	test.AssertEq(row_count, 1, "Clean row is not laid out again");
+	if constexpr (layout_stats_enabled) {
+		test.AssertEq(stats.layout_cache_hits, size_t{1}, "Clean root hits the cache");
+		test.AssertEq(stats.layout_cache_misses, size_t{0}, "Clean elements never miss");
+	}
+
+	// a different rect misses
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 50));
+	test.AssertEq(root_count, 2, "New rect misses the cache");
+
+	// ComputeLayout always lays out, so it picks up fields
+	// changed without MarkDirty
+	row->layout_options.main_gap = Px{5};
+	row->ComputeLayout(row->ComputedRect());
+	test.AssertEq(row_count, 2, "ComputeLayout lays out a clean row");
+	test.AssertEq(
+		row->children[2]->ComputedRect(),
+		PxRect::FromXYWH(30, 0, 10, 10),
+		"Child has wrong layout after change"
+	);
+
+	// the subtrees were not laid out, so a tree layout still visits them
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 50));
+	test.AssertEq(root_count, 3, "Tree layout after ComputeLayout lays out the root");
+}
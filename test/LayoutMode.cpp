@@ -0,0 +1,82 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+namespace {
+	// stacks every child at the top left of the content box
+	struct StackLayoutMode : Klay::LayoutMode {
+		int calls = 0;
+
+		void ComputeLayout(
+			Klay::Element& el,
+			const Klay::PxRect& content_rect
+		) noexcept override {
+			++calls;
+			for (auto& child : el) {
+				child->computed_position = Klay::PxPoint{content_rect.X(), content_rect.Y()};
+				child->computed_size = child->computed_min_size;
+			}
+		}
+	};
+}
+
+TEST_CASE("Flex layout modes are stored inline", LayoutModeInline) {
+	using namespace Klay;
+
+	auto flex = ElementBuilder{}.Flex(Axis::Vertical).Build();
+	const auto* flex_mode = flex->layout_mode.GetIf<FlexLayoutMode>();
+	test.Assert(flex_mode != nullptr, "Flex mode is found");
+	test.Assert(
+		reinterpret_cast<const std::byte*>(flex_mode) >= reinterpret_cast<const std::byte*>(flex.get())
+			&& reinterpret_cast<const std::byte*>(flex_mode) < reinterpret_cast<const std::byte*>(flex.get() + 1),
+		"Flex mode lives in the element"
+	);
+	test.Assert(flex->layout_mode.GetIf<GridLayoutMode>() == nullptr, "Flex is not a grid");
+	test.Assert(flex->layout_mode.get() == flex_mode, "Base pointer is the flex mode");
+
+	// grid modes are kept behind their pointer, so elements stay small
+	auto grid_mode = std::make_unique<GridLayoutMode>();
+	const auto* grid = grid_mode.get();
+	flex->SetLayoutMode(std::move(grid_mode));
+	test.Assert(flex->layout_mode.GetIf<GridLayoutMode>() == grid, "Grid mode is found");
+	test.Assert(flex->layout_mode.GetIf<FlexLayoutMode>() == nullptr, "Grid is not a flex");
+	test.Assert(flex->layout_mode.get() == grid, "Base pointer is the grid mode");
+	test.Assert(
+		sizeof(ElementLayoutMode) < sizeof(GridLayoutMode),
+		"Grid mode is not stored inline"
+	);
+
+	// so are the lines cached by wrapped layouts
+	test.Assert(
+		sizeof(FlexLayoutMode) < sizeof(LayoutMode) + sizeof(std::vector<FlexLine>),
+		"Flex line cache is not stored inline"
+	);
+	auto wrapped = ElementBuilder{}.Flex().Wrap().Build();
+	wrapped->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{10}).Build());
+	test.Assert(wrapped->layout_mode.GetIf<FlexLayoutMode>()->GetLines().empty(), "No lines before layout");
+	wrapped->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	const auto& wrapped_mode = *wrapped->layout_mode.GetIf<FlexLayoutMode>();
+	test.AssertEq(wrapped_mode.GetLines().size(), size_t{1}, "Wrapped layout caches its line");
+	test.Assert(FlexLayoutMode{wrapped_mode}.GetLines().empty(), "Copies start without cached lines");
+
+	flex->SetLayoutMode(nullptr);
+	test.Assert(!flex->layout_mode, "Mode is cleared");
+}
+
+TEST_CASE("Custom layout modes are called through the base", LayoutModeCustom) {
+	using namespace Klay;
+
+	auto mode = std::make_unique<StackLayoutMode>();
+	const auto* stack = mode.get();
+	auto root = ElementBuilder{}.LayoutMode(std::move(mode)).Build();
+	auto child = root->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).Build());
+	root->AddChild(ElementBuilder{}.MinSize(Px{30}, Px{5}).Build());
+
+	test.Assert(root->layout_mode.GetIf<StackLayoutMode>() == stack, "Custom mode is found");
+	test.Assert(root->layout_mode.GetIf<FlexLayoutMode>() == nullptr, "Custom mode is not a flex");
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(5, 5, 100, 100));
+	test.AssertEq(stack->calls, 1, "Custom mode is called once");
+	test.AssertEq(child->ComputedRect(), PxRect::FromXYWH(5, 5, 10, 20), "Child is stacked");
+}
@@ -0,0 +1,146 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace KTest;
+
+namespace {
+	std::shared_ptr<Klay::Element> MakeSnapshotScene() {
+		using namespace Klay;
+
+		auto root = ElementBuilder{}
+			.Flex()
+			.AlignItems(Align::Stretch)
+			.PaddingPxLTRB(5, 5, 5, 5)
+			.Gap(Px{10})
+			.Build();
+		auto column = root->AddChild(
+			ElementBuilder{}
+				.FlexGrow(1)
+				.Flex(Axis::Vertical)
+				.JustifyContent(Justify::Center)
+				.Build()
+		);
+		for (int i = 0; i < 3; ++i) {
+			column->AddChild(
+				ElementBuilder{}.MinSize(Px{10}, Px{20}).Width(Px{30}).Build()
+			);
+		}
+		column->AddChild(ElementBuilder{}.AlignSelf(Align::End).MaxWidth(Px{5}).Build());
+		auto grid = root->AddChild(
+			ElementBuilder{}
+				.FlexGrow(2)
+				.ColumnTracks(GridTrackList{Px{40}, Percent{0.25f}, GridFr{2}})
+				.Gap(Px{4})
+				.Build()
+		);
+		grid->AddChild(ElementBuilder{}.Row(1).Col(2).Build());
+		grid->AddChild(ElementBuilder{}.ColSpan(2).Build());
+		grid->AddChild(ElementBuilder{}.Build());
+		return root;
+	}
+}
+
+TEST_CASE("Layout snapshot round trip", LayoutSnapshotRoundTrip) {
+	using namespace Klay;
+
+	auto root = MakeSnapshotScene();
+	auto tree = LayoutTree::FromElement(*root);
+
+	const auto viewport = PxRect::FromXYWH(0, 0, 300, 200);
+	const auto data = LayoutSnapshot::Write(tree, viewport);
+	const auto snapshot = LayoutSnapshot::Open(data);
+	test.Assert(snapshot.has_value(), "Snapshot opens");
+
+	test.AssertEq(snapshot->Size(), tree.Size(), "Snapshot has every node");
+	test.Assert(snapshot->HasGeometry(), "Snapshot has geometry");
+	test.AssertEq(snapshot->GetViewport(), viewport, "Snapshot keeps the viewport");
+	test.Assert(
+		reinterpret_cast<const std::byte*>(snapshot->min_size.data()) > data.data()
+			&& reinterpret_cast<const std::byte*>(snapshot->computed_rect.data()) < data.data() + data.size(),
+		"Arrays point into the buffer"
+	);
+
+	tree.ComputeLayout(viewport);
+	const auto rects = snapshot->RectsFor(viewport);
+	test.AssertEq(rects.size(), tree.Size(), "Every node has a stored rect");
+	for (NodeHandle node = 0; node < tree.Size(); ++node) {
+		test.AssertEq(rects[node], tree.ComputedRect(node), "Stored rect differs from layout");
+		test.Assert(snapshot->GetAlignSelf(node) == tree.align_self[node], "Align self differs");
+		test.Assert(snapshot->GetPreferredSize(node) == tree.preferred_size[node], "Preferred size differs");
+		const auto placement = snapshot->GetGridPlacement(node);
+		test.Assert(placement.row_start == tree.grid_placement[node].row_start, "Row start differs");
+		test.Assert(placement.col_start == tree.grid_placement[node].col_start, "Col start differs");
+		test.AssertEq(placement.col_span, tree.grid_placement[node].col_span, "Col span differs");
+	}
+
+	const auto other = PxRect::FromXYWH(0, 0, 500, 120);
+	test.Assert(snapshot->RectsFor(other).empty(), "Other viewports have no stored rects");
+
+	auto copy = snapshot->ToLayoutTree();
+	copy.ComputeLayout(other);
+	tree.ComputeLayout(other);
+	for (NodeHandle node = 0; node < tree.Size(); ++node) {
+		test.AssertEq(copy.ComputedRect(node), tree.ComputedRect(node), "Copied tree lays out differently");
+	}
+
+	const auto without_geometry = LayoutSnapshot::Write(tree);
+	const auto plain = LayoutSnapshot::Open(without_geometry);
+	test.Assert(plain.has_value(), "Snapshot without geometry opens");
+	test.Assert(!plain->HasGeometry(), "Snapshot has no geometry");
+	test.Assert(without_geometry.size() < data.size(), "Geometry is left out");
+}
+
+TEST_CASE("Layout snapshot rejects other data", LayoutSnapshotRejects) {
+	using namespace Klay;
+
+	auto root = MakeSnapshotScene();
+	const auto data = LayoutSnapshot::Write(LayoutTree::FromElement(*root), PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.Assert(
+		!LayoutSnapshot::Open(std::span{data}.first(data.size() - 1)).has_value(),
+		"Truncated snapshot is rejected"
+	);
+	test.Assert(
+		!LayoutSnapshot::Open(std::span{data}.first(sizeof(LayoutSnapshotHeader) - 1)).has_value(),
+		"Truncated header is rejected"
+	);
+
+	auto other_version = data;
+	const std::uint32_t version = LayoutSnapshot::version + 1;
+	std::memcpy(other_version.data() + offsetof(LayoutSnapshotHeader, version), &version, sizeof(version));
+	test.Assert(!LayoutSnapshot::Open(other_version).has_value(), "Other versions are rejected");
+
+	auto other_magic = data;
+	other_magic[0] = std::byte{'X'};
+	test.Assert(!LayoutSnapshot::Open(other_magic).has_value(), "Other files are rejected");
+
+	// a grid container whose tracks run past the track section
+	const auto snapshot = LayoutSnapshot::Open(data);
+	const auto grid = std::find_if(
+		snapshot->containers.begin(),
+		snapshot->containers.end(),
+		[](const LayoutSnapshotContainer& container) {
+			return container.mode == LayoutSnapshotMode::Grid;
+		}
+	);
+	test.Assert(grid != snapshot->containers.end(), "Scene has a grid container");
+	auto bad_tracks = data;
+	const auto grid_offset = reinterpret_cast<const std::byte*>(&*grid) - data.data();
+	const std::uint32_t first_track = static_cast<std::uint32_t>(snapshot->tracks.size());
+	std::memcpy(
+		bad_tracks.data() + grid_offset + offsetof(LayoutSnapshotContainer, first_track),
+		&first_track,
+		sizeof(first_track)
+	);
+	test.Assert(!LayoutSnapshot::Open(bad_tracks).has_value(), "Tracks out of range are rejected");
+
+	std::vector<std::byte> shifted(data.size() + LayoutSnapshot::alignment);
+	std::memcpy(shifted.data() + 1, data.data(), data.size());
+	test.Assert(
+		!LayoutSnapshot::Open(std::span{shifted}.subspan(1, data.size())).has_value(),
+		"Misaligned snapshot is rejected"
+	);
+}
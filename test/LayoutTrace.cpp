@@ -0,0 +1,99 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+namespace {
+	bool SameLayout(const Klay::Element& a, const Klay::Element& b) {
+		if (a.ComputedRect() != b.ComputedRect() || a.NumChildren() != b.NumChildren()) {
+			return false;
+		}
+		for (size_t i = 0; i < a.NumChildren(); ++i) {
+			if (!SameLayout(*a.children[i], *b.children[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE("Layout trace replays the recorded calls", LayoutTraceReplay) {
+	using namespace Klay;
+
+	// built before recording starts, so recorded on first use
+	auto root = ElementBuilder{}
+		.Flex()
+		.AlignItems(Align::Stretch)
+		.PaddingPxLTRB(5, 5, 5, 5)
+		.Gap(Px{10})
+		.Build();
+	auto column = root->AddChild(ElementBuilder{}.FlexGrow(1).Flex(Axis::Vertical).Build());
+	column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).Build());
+
+	StartLayoutTrace();
+	test.Assert(IsLayoutTraceRecording(), "Recording started");
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 300, 200));
+
+	auto grid = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(2)
+			.ColumnTracks(GridTrackList{Px{40}, GridFr{1}})
+			.Build()
+	);
+	ElementTreeBuilder builder;
+	const auto cell = builder.Add(ElementBuilder{}.Col(1));
+	builder.Add(ElementBuilder{}.MinSize(Px{5}, Px{5}), cell);
+	grid->AddChild(builder.Build());
+	column->children.front()->SetMaxSize({Px{8}, std::nullopt});
+
+	DamageList damage;
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 400, 200), damage);
+	auto item_options = grid->item_options;
+	item_options.grow = 1;
+	grid->SetItemOptions(item_options);
+	root->ComputeLayout(PxRect::FromXYWH(0, 0, 400, 100));
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 400, 100));
+
+	const auto trace = StopLayoutTrace();
+	test.Assert(!IsLayoutTraceRecording(), "Recording stopped");
+
+	std::vector<std::shared_ptr<Element>> elements;
+	const auto calls = ReplayLayoutTrace(trace, nullptr, &elements);
+	test.Assert(calls.has_value(), "Trace replays");
+	test.AssertEq(calls->size(), size_t{4}, "Every layout call is replayed");
+	test.Assert((*calls)[1].kind == LayoutTraceCallKind::DamageTreeLayout, "Call kind is kept");
+	test.Assert((*calls)[2].kind == LayoutTraceCallKind::Layout, "Call kind is kept");
+	test.AssertEq((*calls)[3].rect, PxRect::FromXYWH(0, 0, 400, 100), "Call rect is kept");
+	test.AssertEq((*calls)[3].element, std::uint32_t{0}, "Calls refer to the root");
+
+	test.AssertEq(elements.size(), size_t{6}, "Every element is replayed");
+	test.Assert(SameLayout(*elements[0], *root), "Replayed tree has the same layout");
+}
+
+TEST_CASE("Layout trace only records changes", LayoutTraceChanges) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().Build();
+	auto child = root->AddChild(ElementBuilder{}.FlexGrow(1).Build());
+
+	StartLayoutTrace();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	const auto size = StopLayoutTrace().size();
+
+	StartLayoutTrace();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	child->SetItemOptions(child->item_options);
+	root->SetLayoutOptions(root->layout_options);
+	const auto unchanged = StopLayoutTrace();
+	test.AssertEq(unchanged.size(), size, "Options set to the same values are not recorded");
+
+	test.Assert(StopLayoutTrace().empty(), "Stopping twice returns nothing");
+	test.Assert(
+		!ReplayLayoutTrace(std::span{unchanged}.first(unchanged.size() - 1)).has_value(),
+		"Truncated trace is rejected"
+	);
+	auto other = unchanged;
+	other[0] = std::byte{'X'};
+	test.Assert(!ReplayLayoutTrace(other).has_value(), "Other data is rejected");
+}
@@ -0,0 +1,214 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+TEST_CASE("Layout tree matches element layout", LayoutTreeMatchesElements) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}
+		.Flex()
+		.AlignItems(Align::Stretch)
+		.PaddingPxLTRB(5, 5, 5, 5)
+		.Gap(Px{10})
+		.Build();
+	auto column = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.Flex(Axis::Vertical)
+			.JustifyContent(Justify::Center)
+			.Build()
+	);
+	for (int i = 0; i < 3; ++i) {
+		column->AddChild(
+			ElementBuilder{}.MinSize(Px{10}, Px{20}).Build()
+		);
+	}
+	auto grid = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(2)
+			.Grid(2, 3)
+			.Gap(Px{4})
+			.Build()
+	);
+	grid->AddChild(ElementBuilder{}.Row(1).Col(2).Build());
+	grid->AddChild(ElementBuilder{}.ColSpan(2).Build());
+	grid->AddChild(ElementBuilder{}.Build());
+	grid->AddChild(ElementBuilder{}.Row(0).Build());
+
+	const auto rect = PxRect::FromXYWH(0, 0, 300, 200);
+	root->ComputeTreeLayout(rect);
+
+	std::vector<const Element*> elements;
+	auto tree = LayoutTree::FromElement(*root, &elements);
+
+	test.AssertEq(tree.Size(), size_t{10}, "Tree has every element");
+	test.AssertEq(tree.Size(), elements.size(), "Every handle has an element");
+	test.Assert(elements[0] == root.get(), "Root is the first handle");
+
+	tree.ComputeLayout(rect);
+
+	test.AssertEq(tree.ComputedRect(0), rect, "Root is given the rect");
+	for (NodeHandle node = 1; node < tree.Size(); ++node) {
+		test.AssertEq(
+			tree.ComputedRect(node),
+			elements[node]->ComputedRect(),
+			"Tree node has wrong layout"
+		);
+		test.AssertEq(
+			tree.computed_min_size[node],
+			elements[node]->computed_min_size,
+			"Tree node has wrong min size"
+		);
+	}
+}
+
+TEST_CASE("Layout tree resolves percent padding like elements", LayoutTreePercentPadding) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}
+		.Flex()
+		.AlignItems(Align::Stretch)
+		.PaddingPercentLTRB(0.05f, 0.05f, 0.05f, 0.05f)
+		.Build();
+	auto column = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.Flex(Axis::Vertical)
+			.PaddingLeft(Percent{0.1f})
+			.PaddingRight(Px{4})
+			.PaddingTop(Percent{0.02f})
+			.Build()
+	);
+	column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).PaddingTop(Percent{0.1f}).Build());
+	column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).Build());
+	// as wide as its padding
+	root->AddChild(
+		ElementBuilder{}
+			.PaddingLeft(Percent{0.2f})
+			.PaddingRight(Percent{0.2f})
+			.MinHeight(Px{10})
+			.Build()
+	);
+
+	std::vector<const Element*> elements;
+	auto tree = LayoutTree::FromElement(*root, &elements);
+	auto copy = LayoutSnapshot::Open(LayoutSnapshot::Write(tree))->ToLayoutTree();
+
+	for (const auto& rect : { PxRect::FromXYWH(0, 0, 300, 200), PxRect::FromXYWH(10, 20, 120, 400) }) {
+		root->ComputeTreeLayout(rect);
+		tree.ComputeLayout(rect);
+		copy.ComputeLayout(rect);
+		for (NodeHandle node = 1; node < tree.Size(); ++node) {
+			test.AssertEq(
+				tree.ComputedRect(node),
+				elements[node]->ComputedRect(),
+				"Tree node has wrong layout"
+			);
+			test.AssertEq(
+				copy.ComputedRect(node),
+				elements[node]->ComputedRect(),
+				"Snapshot node has wrong layout"
+			);
+		}
+	}
+	test.AssertEq(
+		elements[2]->ComputedRect().Width(),
+		Px{0.4f * 108},
+		"Padding should resolve against the content box of the parent"
+	);
+}
+
+TEST_CASE("Layout tree built by handle", LayoutTreeByHandle) {
+	using namespace Klay;
+
+	LayoutTree tree;
+	const auto root = tree.AddRoot();
+	tree.SetLayoutMode(root, FlexLayoutMode{Axis::Vertical});
+
+	const auto first = tree.AddChildren(root, 2);
+	tree.min_size[first] = PxSize{10, 10};
+	tree.grow[first + 1] = 1;
+	tree.align_self[first + 1] = Align::Stretch;
+
+	tree.ComputeLayout(PxRect::FromXYWH(0, 0, 50, 100));
+
+	test.AssertEq(tree.parent[first + 1], root, "Children have root as parent");
+	test.AssertEq(
+		tree.ComputedRect(first),
+		PxRect::FromXYWH(0, 0, 10, 10),
+		"Child 1 has wrong layout"
+	);
+	test.AssertEq(
+		tree.ComputedRect(first + 1),
+		PxRect::FromXYWH(0, 10, 50, 90),
+		"Child 2 has wrong layout"
+	);
+}
+
+TEST_CASE("Layout tree size limits", LayoutTreeSizeLimits) {
+	using namespace Klay;
+
+	LayoutTree tree;
+	const auto root = tree.AddRoot();
+	tree.SetLayoutMode(root, FlexLayoutMode{Axis::Vertical});
+
+	const auto first = tree.AddChildren(root, 2);
+	tree.SetSizeLimits(first, OptionalPxSize{Px{20}, Px{15}});
+	tree.grow[first + 1] = 1;
+	tree.align_self[first + 1] = Align::Stretch;
+	tree.SetSizeLimits(first + 1, OptionalPxSize{}, PxSize{30, 40});
+
+	tree.ComputeLayout(PxRect::FromXYWH(0, 0, 50, 100));
+
+	test.AssertEq(
+		tree.ComputedRect(first),
+		PxRect::FromXYWH(0, 0, 20, 15),
+		"Child 1 should take its preferred size"
+	);
+	test.AssertEq(
+		tree.ComputedRect(first + 1),
+		PxRect::FromXYWH(0, 15, 30, 40),
+		"Child 2 should stop at its max size"
+	);
+}
+
+TEST_CASE("Layout tree keeps grids out of flex containers", LayoutTreeGridSideArray) {
+	using namespace Klay;
+
+	static_assert(sizeof(LayoutTree::Container) < sizeof(GridLayoutMode));
+
+	LayoutTree tree;
+	const auto root = tree.AddRoot();
+	tree.SetLayoutMode(root, FlexLayoutMode{Axis::Vertical});
+	const auto first = tree.AddChildren(root, 2);
+	tree.min_size[first] = PxSize{10, 10};
+	tree.min_size[first + 1] = PxSize{10, 10};
+	test.AssertEq(tree.grids.size(), size_t{0}, "Flex containers should not have a grid");
+
+	LayoutOptions grid_options;
+	grid_options.num_rows = 1;
+	grid_options.num_columns = 2;
+	tree.SetLayoutMode(root, GridLayoutMode{}, grid_options);
+	tree.grid_placement[first] = GridItemPlacement{0, 1, 0, 1};
+	tree.grid_placement[first + 1] = GridItemPlacement{0, 1, 1, 1};
+	tree.ComputeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.AssertEq(tree.grids.size(), size_t{1}, "Grid container should add a grid");
+	test.AssertEq(
+		tree.ComputedRect(first + 1).Horizontal().start,
+		Px{50},
+		"Grid should place child 2 in the second column"
+	);
+
+	tree.SetLayoutMode(root, FlexLayoutMode{Axis::Vertical});
+	tree.ComputeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.Assert(
+		std::holds_alternative<FlexLayoutMode>(tree.GetLayoutMode(root)),
+		"Root should be a flex container again"
+	);
+	test.AssertEq(
+		tree.ComputedRect(first + 1),
+		PxRect::FromXYWH(0, 10, 10, 10),
+		"Flex should place child 2 below child 1"
+	);
+}
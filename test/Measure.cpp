@@ -0,0 +1,90 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <cmath>
+
+using namespace KTest;
+
+namespace {
+	// text of a fixed length that wraps into 10px lines
+	Klay::MeasureFunction MeasureText(float length, int* calls) {
+		return [length, calls](const Klay::Element&, Klay::Px available_width, Klay::MeasureMode mode) {
+			++*calls;
+			if (mode == Klay::MeasureMode::Undefined || available_width >= length) {
+				return Klay::PxSize{length, 10};
+			}
+			const float lines = std::ceil(length / std::max(available_width.value, 1.0f));
+			return Klay::PxSize{available_width, 10 * lines};
+		};
+	}
+}
+
+TEST_CASE("Measured leaves size their min size", MeasureMinSize) {
+	using namespace Klay;
+
+	int calls = 0;
+	auto root = ElementBuilder{}.Flex().Build();
+	auto label = root->AddChild(ElementBuilder{}.PaddingPxLTRB(1, 2, 1, 2).Build());
+	label->SetMeasureFunction(MeasureText(120, &calls));
+
+	root->ComputeMinSize();
+	test.AssertEq(label->computed_min_size, PxSize{122, 14}, "Label has wrong min size");
+	test.AssertEq(root->computed_min_size, PxSize{122, 14}, "Root has wrong min size");
+	test.AssertEq(calls, 1, "Measure should be called once");
+}
+
+TEST_CASE("Measured leaves wrap to the available width", MeasureWraps) {
+	using namespace Klay;
+
+	int calls = 0;
+	auto root = ElementBuilder{}
+		.Flex(Axis::Vertical)
+		.AlignItems(Align::Stretch)
+		.Build();
+	auto label = root->AddChild(ElementBuilder{}.Build());
+	label->SetMeasureFunction(MeasureText(120, &calls));
+	auto after = root->AddChild(ElementBuilder{}.MinHeight(Px{5}).Build());
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 100));
+	test.AssertEq(label->ComputedRect(), PxRect::FromXYWH(0, 0, 50, 30), "Label did not wrap");
+	test.AssertEq(after->ComputedRect(), PxRect::FromXYWH(0, 30, 50, 5), "Item after label has wrong layout");
+	test.AssertEq(calls, 2, "Expected one natural and one wrapped measurement");
+
+	// resizing back and forth reuses cached measurements
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 60, 100));
+	test.AssertEq(label->ComputedRect(), PxRect::FromXYWH(0, 0, 60, 20), "Label did not rewrap");
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 50, 100));
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 60, 100));
+	test.AssertEq(calls, 3, "Measurements were not cached by width");
+
+	// changing the label drops its cache
+	label->SetMeasureFunction(MeasureText(30, &calls));
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 60, 100));
+	test.AssertEq(label->ComputedRect(), PxRect::FromXYWH(0, 0, 60, 10), "Label was not remeasured");
+	test.AssertEq(calls, 5, "Expected a new natural and wrapped measurement");
+}
+
+TEST_CASE("Resizing only measures labels whose constraint changed", MeasureOnlyChanged) {
+	using namespace Klay;
+
+	int calls = 0;
+	auto root = ElementBuilder{}
+		.Grid(1, 2)
+		.ColumnTracks(GridTrackList{Px{100}, GridFr{1}})
+		.Build();
+	auto fixed = root->AddChild(
+		ElementBuilder{}.Flex(Axis::Vertical).AlignItems(Align::Stretch).Build()
+	);
+	auto growing = root->AddChild(
+		ElementBuilder{}.Flex(Axis::Vertical).AlignItems(Align::Stretch).Build()
+	);
+	for (int i = 0; i < 50; ++i) {
+		fixed->AddChild(ElementBuilder{}.Build())->SetMeasureFunction(MeasureText(80, &calls));
+		growing->AddChild(ElementBuilder{}.Build())->SetMeasureFunction(MeasureText(80, &calls));
+	}
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 150, 1000));
+	calls = 0;
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 170, 1000));
+	test.AssertEq(calls, 50, "Only labels in the growing column should be measured");
+}
@@ -0,0 +1,118 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace KTest;
+
+namespace {
+	// side by side panels, each a column of rows holding a grid
+	std::shared_ptr<Klay::Element> BuildPanels() {
+		using namespace Klay;
+
+		auto root = ElementBuilder{}
+			.Flex()
+			.AlignItems(Align::Stretch)
+			.MainGap(Px{3})
+			.Build();
+		for (int panel = 0; panel < 4; ++panel) {
+			auto column = root->AddChild(
+				ElementBuilder{}
+					.FlexGrow(1 + panel % 2)
+					.Flex(Axis::Vertical)
+					.AlignItems(Align::Stretch)
+					.PaddingPercentLTRB(Percent{0.03f}, Percent{0.01f}, Percent{0.02f}, Percent{0.01f})
+					.Build()
+			);
+			for (int row = 0; row < 20; ++row) {
+				auto grid = column->AddChild(
+					ElementBuilder{}
+						.FlexGrow(1.0f / (row + 1))
+						.Grid(2, 3)
+						.MainGap(Percent{0.01f})
+						.MinHeight(Px{5})
+						.Build()
+				);
+				for (int cell = 0; cell < 7; ++cell) {
+					grid->AddChild(
+						ElementBuilder{}.ColSpan(1 + cell % 2).MinWidth(Px{7}).Build()
+					);
+				}
+			}
+		}
+		return root;
+	}
+
+	void CollectRects(const Klay::Element& element, std::vector<Klay::PxRect>& rects) {
+		rects.push_back(element.ComputedRect());
+		for (const auto& child : element) {
+			CollectRects(*child, rects);
+		}
+	}
+}
+
+TEST_CASE("Parallel tree layout matches the serial pass", ParallelLayoutMatchesSerial) {
+	using namespace Klay;
+
+	const auto rect = PxRect::FromXYWH(0, 0, 1237, 911);
+
+	auto serial = BuildPanels();
+	serial->ComputeTreeLayout(rect);
+	std::vector<PxRect> serial_rects;
+	CollectRects(*serial, serial_rects);
+
+	for (size_t num_threads : {0, 1, 4}) {
+		ThreadPool pool{num_threads};
+		auto parallel = BuildPanels();
+		parallel->ComputeTreeLayout(rect, pool, 8);
+
+		std::vector<PxRect> parallel_rects;
+		CollectRects(*parallel, parallel_rects);
+		test.AssertEq(parallel_rects.size(), serial_rects.size(), "Trees differ");
+		for (size_t i = 0; i < serial_rects.size(); ++i) {
+			test.AssertEq(parallel_rects[i], serial_rects[i], "Rect differs from serial layout");
+		}
+
+		// relayout after a change deep in one panel
+		parallel->children[2]->children[5]->SetMinSize(OptionalSize{Px{0}, Px{40}});
+		serial->children[2]->children[5]->SetMinSize(OptionalSize{Px{0}, Px{40}});
+		parallel->ComputeTreeLayout(rect, pool, 8);
+		serial->ComputeTreeLayout(rect);
+
+		serial_rects.clear();
+		parallel_rects.clear();
+		CollectRects(*serial, serial_rects);
+		CollectRects(*parallel, parallel_rects);
+		for (size_t i = 0; i < serial_rects.size(); ++i) {
+			test.AssertEq(parallel_rects[i], serial_rects[i], "Relayout differs from serial layout");
+		}
+		test.Assert(!parallel->dirty_layout, "Parallel layout left the root dirty");
+
+		serial = BuildPanels();
+		serial->ComputeTreeLayout(rect);
+		serial_rects.clear();
+		CollectRects(*serial, serial_rects);
+	}
+}
+
+TEST_CASE("Thread pool wait sleeps until slow tasks finish", ThreadPoolWaitSleeps) {
+	using namespace Klay;
+
+	ThreadPool pool{2};
+	ThreadPool::TaskGroup group;
+	std::atomic<int> done = 0;
+	for (int i = 0; i < 4; ++i) {
+		pool.Spawn(group, [&] {
+			// long enough for the waiter to stop spinning
+			std::this_thread::sleep_for(std::chrono::milliseconds{5});
+			ThreadPool::TaskGroup inner;
+			pool.Spawn(inner, [&] { done.fetch_add(1); });
+			pool.Wait(inner);
+		});
+	}
+	pool.Wait(group);
+	test.AssertEq(done.load(), 4, "Wait returned before every task finished");
+}
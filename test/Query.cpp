@@ -0,0 +1,78 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <vector>
+
+using namespace KTest;
+
+namespace {
+	// a row of two columns, each with two rows of leaves
+	struct QueryScene {
+		std::shared_ptr<Klay::Element> root;
+		std::shared_ptr<Klay::Element> columns[2];
+		std::shared_ptr<Klay::Element> leaves[4];
+	};
+
+	QueryScene BuildQueryScene() {
+		using namespace Klay;
+
+		QueryScene scene;
+		scene.root = ElementBuilder{}.Flex().AlignItems(Align::Stretch).Build();
+		for (int i = 0; i < 2; ++i) {
+			scene.columns[i] = scene.root->AddChild(
+				ElementBuilder{}
+					.FlexGrow(1)
+					.Flex(Axis::Vertical)
+					.AlignItems(Align::Stretch)
+					.PaddingPxLTRB(5, 5, 5, 5)
+					.Build()
+			);
+			for (int j = 0; j < 2; ++j) {
+				scene.leaves[i * 2 + j] = scene.columns[i]->AddChild(
+					ElementBuilder{}.FlexGrow(1).Build()
+				);
+			}
+		}
+		scene.root->ComputeTreeLayout(Klay::PxRect::FromXYWH(0, 0, 100, 100));
+		return scene;
+	}
+}
+
+TEST_CASE("Query point finds the deepest element", QueryPointDeepest) {
+	using namespace Klay;
+
+	auto scene = BuildQueryScene();
+
+	test.Assert(scene.root->QueryPoint(PxPoint{10, 10}) == scene.leaves[0], "Expected leaf 0");
+	test.Assert(scene.root->QueryPoint(PxPoint{60, 80}) == scene.leaves[3], "Expected leaf 3");
+	// inside the padding of column 1
+	test.Assert(scene.root->QueryPoint(PxPoint{52, 50}) == scene.columns[1], "Expected column 1");
+	test.Assert(scene.root->QueryPoint(PxPoint{150, 50}) == nullptr, "Expected no hit outside the root");
+
+	// moving a leaf updates the bounds of its ancestors only
+	scene.leaves[1]->SetMinSize(OptionalSize{Px{0}, Px{80}});
+	scene.root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.Assert(scene.root->QueryPoint(PxPoint{10, 7}) == scene.leaves[0], "Expected leaf 0 after relayout");
+	test.Assert(scene.root->QueryPoint(PxPoint{10, 20}) == scene.leaves[1], "Expected leaf 1 after relayout");
+}
+
+TEST_CASE("Query rect finds every intersecting element", QueryRectAll) {
+	using namespace Klay;
+
+	auto scene = BuildQueryScene();
+
+	std::vector<std::shared_ptr<Element>> hits;
+	scene.root->QueryRect(PxRect::FromXYWH(40, 60, 20, 10), hits);
+
+	const std::vector<std::shared_ptr<Element>> expected {
+		scene.root,
+		scene.columns[0],
+		scene.leaves[1],
+		scene.columns[1],
+		scene.leaves[3],
+	};
+	test.AssertEq(hits.size(), expected.size(), "Wrong number of hits");
+	for (size_t i = 0; i < std::min(hits.size(), expected.size()); ++i) {
+		test.Assert(hits[i] == expected[i], "Wrong hit");
+	}
+}
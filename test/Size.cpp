@@ -57,4 +57,99 @@ TEST_CASE("Minimum size with children", MinSizeWithPadding) {
 		PxSize { 190, 210 },
 		"Min size is sum of children min size if children are bigger"
 	);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Unit resolution", UnitResolve) {
+	using namespace Klay;
+
+	static_assert(sizeof(Unit) == 2 * sizeof(float));
+	static_assert(Unit{Px{5}}.Resolve(200) == 5.0f);
+	static_assert(Unit{Percent{0.25f}}.Resolve(200) == 50.0f);
+	static_assert(Unit{Px{5}}.Is<Px>() && !Unit{Px{5}}.Is<Percent>());
+	static_assert(Unit{Percent{0.25f}}.TryGet<Percent>()->value == 0.25f);
+	static_assert(!Unit{Percent{0.25f}}.TryGet<Px>());
+
+	LayoutOptions options;
+	options.padding.Horizontal() = EdgeLength<Unit>{Px{1}, Percent{0.1f}};
+	options.padding.Vertical() = EdgeLength<Unit>{Percent{0.5f}, Px{2}};
+	options.main_gap = Percent{0.1f};
+	options.cross_gap = Px{3};
+
+	const auto padding = ResolvePadding(options.padding, PxSize{100, 20});
+	test.AssertEq(padding.Horizontal().Start(), Px{1}, "Wrong left padding");
+	test.AssertEq(padding.Horizontal().End(), Px{10}, "Wrong right padding");
+	test.AssertEq(padding.Vertical().Start(), Px{10}, "Wrong top padding");
+	test.AssertEq(padding.Vertical().End(), Px{2}, "Wrong bottom padding");
+
+	const auto gaps = ResolveGaps(options, PxRect::FromWH(100, 20), Axis::Vertical);
+	test.AssertEq(gaps.main, Px{2}, "Main gap should resolve against the main axis");
+	test.AssertEq(gaps.cross, Px{3}, "Wrong cross gap");
+}
+
+TEST_CASE("Percent sizes resolve against the parent content box", PercentSizes) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().PaddingPxLTRB(10, 0, 10, 0).Build();
+	auto min = root->AddChild(ElementBuilder{}.MinWidth(Percent{0.25f}).MinHeight(Px{10}).Build());
+	auto preferred = root->AddChild(ElementBuilder{}.Width(Percent{0.5f}).MaxWidth(Px{120}).Build());
+	auto max = root->AddChild(ElementBuilder{}.FlexGrow(1).MaxWidth(Percent{0.1f}).Build());
+
+	// intrinsic sizes leave percentages unresolved
+	root->ComputeMinSize();
+	test.AssertEq(min->computed_min_size, PxSize{0, 10}, "Percent min size should be unresolved");
+	test.AssertEq(root->computed_min_size, PxSize{20, 10}, "Percent min size should not reach the parent");
+
+	// content box of 200px
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 220, 50));
+	test.AssertEq(min->ComputedRect(), PxRect::FromXYWH(10, 0, 50, 10), "Min child has wrong layout");
+	test.AssertEq(preferred->ComputedRect(), PxRect::FromXYWH(60, 0, 100, 0), "Preferred child has wrong layout");
+	test.AssertEq(max->ComputedRect(), PxRect::FromXYWH(160, 0, 20, 0), "Max child has wrong layout");
+
+	// only the viewport changes: the percentages follow in the same pass,
+	// and the px max of the preferred child now applies
+	ResetLayoutStats();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 420, 50));
+	test.AssertEq(min->ComputedRect(), PxRect::FromXYWH(10, 0, 100, 10), "Min child has wrong layout");
+	test.AssertEq(preferred->ComputedRect(), PxRect::FromXYWH(110, 0, 120, 0), "Preferred child has wrong layout");
+	test.AssertEq(max->ComputedRect(), PxRect::FromXYWH(230, 0, 40, 0), "Max child has wrong layout");
+	if constexpr (layout_stats_enabled) {
+		test.AssertEq(GetLayoutStats().min_size_computes, size_t{0}, "Viewport change recomputed min sizes");
+	}
+}
+
+TEST_CASE("Percent padding resolves against the parent content box", PercentPadding) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().Build();
+	auto padded = root->AddChild(
+		ElementBuilder{}
+			.PaddingLeft(Percent{0.2f})
+			.PaddingRight(Percent{0.2f})
+			.MinHeight(Px{10})
+			.Build()
+	);
+	auto min = root->AddChild(
+		ElementBuilder{}
+			.PaddingLeft(Percent{0.1f})
+			.MinWidth(Px{30})
+			.Build()
+	);
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 50));
+	test.AssertEq(padded->computed_min_size, PxSize{0, 10}, "Percent padding should be unresolved");
+	test.AssertEq(padded->ComputedRect(), PxRect::FromXYWH(0, 0, 40, 10), "Padded child has wrong layout");
+	test.AssertEq(min->ComputedRect(), PxRect::FromXYWH(40, 0, 30, 0), "Min size should cover the padding");
+
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 200, 50));
+	test.AssertEq(padded->ComputedRect(), PxRect::FromXYWH(0, 0, 80, 10), "Padding should follow the viewport");
+
+	// the padding laid out is the padding the min size reserves,
+	// both a percentage of the content box of the parent
+	auto outer = ElementBuilder{}.Flex().PaddingPercentLTRB(0.1f, 0.1f, 0.1f, 0.1f).Build();
+	auto box = outer->AddChild(ElementBuilder{}.Flex().PaddingLeft(Percent{0.25f}).Build());
+	auto content = box->AddChild(ElementBuilder{}.MinSize(Px{30}, Px{10}).Build());
+
+	outer->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.AssertEq(box->ComputedRect(), PxRect::FromXYWH(10, 10, 50, 10), "Box should fit its padding and content");
+	test.AssertEq(content->ComputedRect(), PxRect::FromXYWH(30, 10, 30, 10), "Content should fill the box after the padding");
+}
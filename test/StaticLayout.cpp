@@ -0,0 +1,198 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+namespace {
+	using namespace Klay;
+
+	constexpr auto MakeStaticElements() {
+		LayoutOptions root_options;
+		root_options.align_items = Align::Stretch;
+		root_options.main_gap = Px{10};
+		root_options.cross_gap = Px{10};
+		for (auto& edge : root_options.padding.axes) {
+			edge = EdgeLength<Unit>{Px{5}, Px{5}};
+		}
+
+		LayoutOptions column_options;
+		column_options.justify_content = Justify::Center;
+
+		LayoutOptions grid_options;
+		grid_options.num_rows = 2;
+		grid_options.num_columns = 3;
+		grid_options.main_gap = Px{4};
+		grid_options.cross_gap = Px{4};
+
+		std::array<StaticElement, 10> elements {};
+		elements[0].layout = StaticLayoutKind::Flex;
+		elements[0].layout_options = root_options;
+
+		elements[1].parent = 0;
+		elements[1].layout = StaticLayoutKind::Flex;
+		elements[1].main_axis = Axis::Vertical;
+		elements[1].layout_options = column_options;
+		elements[1].grow = 1;
+		for (size_t i = 2; i < 5; ++i) {
+			elements[i].parent = 1;
+			elements[i].min_size = PxSize{10, 20};
+		}
+
+		elements[5].parent = 0;
+		elements[5].layout = StaticLayoutKind::Grid;
+		elements[5].layout_options = grid_options;
+		elements[5].grow = 2;
+		for (size_t i = 6; i < 10; ++i) {
+			elements[i].parent = 5;
+		}
+		elements[6].placement = GridItemPlacement{1, 1, 2, 1};
+		elements[7].placement.col_span = 2;
+		elements[9].placement.row_start = 0;
+		return elements;
+	}
+
+	constexpr auto viewport = PxRect::FromXYWH(0, 0, 300, 200);
+	constexpr StaticLayout static_layout {MakeStaticElements(), viewport};
+
+	// the layout is computed by the compiler
+	static_assert(static_layout.rects[0] == viewport);
+	static_assert(static_layout.rects[2].Height() == 20);
+
+	constexpr auto MakeShrinkingRow() {
+		std::array<StaticElement, 3> elements {};
+		elements[0].layout = StaticLayoutKind::Flex;
+		elements[1].parent = 0;
+		elements[1].preferred_size = OptionalPxSize{Px{100}, Px{10}};
+		elements[1].shrink = 1;
+		elements[2].parent = 0;
+		elements[2].preferred_size = OptionalPxSize{Px{300}, Px{10}};
+		elements[2].shrink = 1;
+		return elements;
+	}
+
+	// shrinking resolves at compile time too
+	constexpr auto shrunk = ComputeStaticLayout(MakeShrinkingRow(), PxRect::FromWH(200, 10));
+	static_assert(shrunk[1].Width() == 50 && shrunk[2] == PxRect::FromXYWH(50, 0, 150, 10));
+
+	constexpr auto MakePercentPaddingElements() {
+		std::array<StaticElement, 5> elements {};
+		elements[0].layout = StaticLayoutKind::Flex;
+		elements[0].layout_options.align_items = Align::Stretch;
+		for (auto& edge : elements[0].layout_options.padding.axes) {
+			edge = EdgeLength<Unit>{Percent{0.05f}, Percent{0.05f}};
+		}
+
+		elements[1].parent = 0;
+		elements[1].layout = StaticLayoutKind::Flex;
+		elements[1].main_axis = Axis::Vertical;
+		elements[1].grow = 1;
+		elements[1].layout_options.padding.Horizontal() = EdgeLength<Unit>{Percent{0.1f}, Px{4}};
+		elements[1].layout_options.padding.Vertical().Start() = Percent{0.02f};
+
+		elements[2].parent = 0;
+		elements[2].min_size = PxSize{0, 10};
+		elements[2].layout_options.padding.Horizontal() = EdgeLength<Unit>{Percent{0.2f}, Percent{0.2f}};
+
+		for (size_t i = 3; i < 5; ++i) {
+			elements[i].parent = 1;
+			elements[i].min_size = PxSize{10, 20};
+		}
+		elements[3].layout_options.padding.Vertical().Start() = Percent{0.1f};
+		return elements;
+	}
+
+	constexpr StaticLayout percent_padding_layout {MakePercentPaddingElements(), viewport};
+}
+
+TEST_CASE("Static layout matches element layout", StaticLayoutMatchesElements) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}
+		.Flex()
+		.AlignItems(Align::Stretch)
+		.PaddingPxLTRB(5, 5, 5, 5)
+		.Gap(Px{10})
+		.Build();
+	std::vector<std::shared_ptr<Element>> elements { root };
+	auto column = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.Flex(Axis::Vertical)
+			.JustifyContent(Justify::Center)
+			.Build()
+	);
+	elements.push_back(column);
+	for (int i = 0; i < 3; ++i) {
+		elements.push_back(column->AddChild(
+			ElementBuilder{}.MinSize(Px{10}, Px{20}).Build()
+		));
+	}
+	auto grid = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(2)
+			.Grid(2, 3)
+			.Gap(Px{4})
+			.Build()
+	);
+	elements.push_back(grid);
+	elements.push_back(grid->AddChild(ElementBuilder{}.Row(1).Col(2).Build()));
+	elements.push_back(grid->AddChild(ElementBuilder{}.ColSpan(2).Build()));
+	elements.push_back(grid->AddChild(ElementBuilder{}.Build()));
+	elements.push_back(grid->AddChild(ElementBuilder{}.Row(0).Build()));
+
+	for (const auto& other : { viewport, PxRect::FromXYWH(10, 20, 120, 400) }) {
+		root->ComputeTreeLayout(other);
+		const auto rects = static_layout.RectsFor(other);
+		test.AssertEq(rects[0], other, "Root is given the viewport");
+		for (size_t i = 1; i < elements.size(); ++i) {
+			test.AssertEq(
+				rects[i],
+				elements[i]->ComputedRect(),
+				"Static element has wrong layout"
+			);
+		}
+	}
+}
+
+TEST_CASE("Static layout resolves percent padding like elements", StaticLayoutPercentPadding) {
+	using namespace Klay;
+
+	// in the order of MakePercentPaddingElements
+	auto root = ElementBuilder{}
+		.Flex()
+		.AlignItems(Align::Stretch)
+		.PaddingPercentLTRB(0.05f, 0.05f, 0.05f, 0.05f)
+		.Build();
+	std::vector<std::shared_ptr<Element>> elements { root };
+	auto column = root->AddChild(
+		ElementBuilder{}
+			.FlexGrow(1)
+			.Flex(Axis::Vertical)
+			.PaddingLeft(Percent{0.1f})
+			.PaddingRight(Px{4})
+			.PaddingTop(Percent{0.02f})
+			.Build()
+	);
+	elements.push_back(column);
+	elements.push_back(root->AddChild(
+		ElementBuilder{}
+			.PaddingLeft(Percent{0.2f})
+			.PaddingRight(Percent{0.2f})
+			.MinHeight(Px{10})
+			.Build()
+	));
+	elements.push_back(column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).PaddingTop(Percent{0.1f}).Build()));
+	elements.push_back(column->AddChild(ElementBuilder{}.MinSize(Px{10}, Px{20}).Build()));
+
+	for (const auto& other : { viewport, PxRect::FromXYWH(10, 20, 120, 400) }) {
+		root->ComputeTreeLayout(other);
+		const auto rects = percent_padding_layout.RectsFor(other);
+		for (size_t i = 1; i < elements.size(); ++i) {
+			test.AssertEq(
+				rects[i],
+				elements[i]->ComputedRect(),
+				"Static element has wrong layout"
+			);
+		}
+	}
+}
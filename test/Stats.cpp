@@ -0,0 +1,71 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <type_traits>
+
+using namespace KTest;
+
+TEST_CASE("Layout stats count visits and layout mode calls", LayoutStatsCounts) {
+	using namespace Klay;
+
+	auto root = ElementBuilder{}.Flex().AlignItems(Align::Stretch).Build();
+	auto grid = root->AddChild(
+		ElementBuilder{}.FlexGrow(1).Grid(1, 2).Build()
+	);
+	for (int i = 0; i < 3; ++i) {
+		grid->AddChild(ElementBuilder{}.MinHeight(Px{10}).Build());
+	}
+
+	ResetLayoutStats();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	const auto stats = GetLayoutStats();
+
+	if constexpr (!layout_stats_enabled) {
+		test.AssertEq(stats.elements_visited, size_t{0}, "Stats collected while disabled");
+		test.AssertEq(stats.layout_time.count(), 0ll, "Stats timed while disabled");
+		return;
+	}
+
+	test.AssertEq(stats.elements_visited, size_t{5}, "Wrong number of elements visited");
+	test.AssertEq(stats.min_size_computes, size_t{5}, "Wrong number of min sizes computed");
+	test.AssertEq(stats.layout_mode_calls, size_t{2}, "Wrong number of layout mode calls");
+	test.AssertEq(stats.grid_layout_calls, size_t{1}, "Wrong number of grid layouts");
+	test.AssertEq(stats.flex_layout_calls, size_t{1}, "Wrong number of flex layouts");
+	// the third item misses the full first row, then fits the second
+	test.AssertEq(stats.grid_cell_probes, size_t{4}, "Wrong number of grid probes");
+	test.Assert(stats.scratch_growths > 0, "First grid layout should grow its scratch");
+
+	// a clean relayout only visits the root
+	ResetLayoutStats();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	const auto clean_stats = GetLayoutStats();
+	test.AssertEq(clean_stats.elements_visited, size_t{1}, "Clean relayout visited children");
+	test.AssertEq(clean_stats.min_size_computes, size_t{0}, "Clean relayout computed min sizes");
+	test.AssertEq(clean_stats.layout_mode_calls, size_t{0}, "Clean relayout called layout modes");
+
+	// the grid reuses its scratch once it has seen the items
+	for (int i = 0; i < 2; ++i) {
+		ResetLayoutStats();
+		grid->MarkDirty();
+		root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	}
+	test.AssertEq(GetLayoutStats().scratch_growths, size_t{0}, "Grid relayout grew its scratch");
+
+	// a wrapped flex container grows its line cache on its first layout
+	auto wrapped = ElementBuilder{}.Flex().Wrap().Build();
+	for (int i = 0; i < 4; ++i) {
+		wrapped->AddChild(ElementBuilder{}.MinSize(Px{60}, Px{10}).Build());
+	}
+	ResetLayoutStats();
+	wrapped->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	test.Assert(GetLayoutStats().scratch_growths > 0, "First wrapped layout should grow its lines");
+	for (int i = 0; i < 2; ++i) {
+		ResetLayoutStats();
+		wrapped->MarkDirty();
+		wrapped->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+	}
+	test.AssertEq(GetLayoutStats().scratch_growths, size_t{0}, "Wrapped relayout grew its lines");
+}
+
+// the timers cost nothing when stats are off
+static_assert(Klay::layout_stats_enabled || std::is_empty_v<Klay::LayoutPhaseTimer>);
@@ -0,0 +1,38 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+using namespace KTest;
+
+namespace {
+	struct Color {
+		unsigned char r, g, b, a;
+	};
+
+	// trivially copyable, but not default constructible
+	struct Handle {
+		explicit Handle(int index) : index{index} {}
+		int index;
+	};
+}
+
+TEST_CASE("User data holds small trivially copyable payloads", UserDataPayload) {
+	using namespace Klay;
+
+	auto element = ElementBuilder{}.UserData(Color{1, 2, 3, 4}).Build();
+	const auto color = element->user_data.Get<Color>();
+	test.Assert(
+		color.r == 1 && color.g == 2 && color.b == 3 && color.a == 4,
+		"Color was not stored"
+	);
+
+	int value = 7;
+	element->user_data.Set(&value);
+	test.AssertEq(*element->user_data.Get<int*>(), 7, "Pointer was not stored");
+
+	element->user_data.Set(Handle{3});
+	test.AssertEq(element->user_data.Get<Handle>().index, 3, "Handle was not stored");
+
+	static_assert(UserData::fits<double>);
+	static_assert(!UserData::fits<std::shared_ptr<int>>);
+	static_assert(!UserData::fits<char[UserData::capacity + 1]>);
+}
@@ -0,0 +1,119 @@
+#include <klay/Klay.hpp>
+#include <ktest/KTest.hpp>
+
+#include <vector>
+
+using namespace KTest;
+
+TEST_CASE("Extent tree offsets and lookups", ExtentTreeQueries) {
+	using namespace Klay;
+
+	ExtentTree extents;
+	extents.assign(10, Px{10});
+	test.AssertEq(extents.total(), Px{100}, "Wrong total");
+	test.AssertEq(extents.offset(3), Px{30}, "Wrong offset");
+	test.AssertEq(extents.find(Px{35}), size_t{3}, "Wrong row at offset");
+	test.AssertEq(extents.find(Px{30}), size_t{3}, "Row start belongs to the row");
+	test.AssertEq(extents.find(Px{-5}), size_t{0}, "Offsets before the list should give 0");
+	test.AssertEq(extents.find(Px{100}), size_t{10}, "Offsets past the list should give size");
+
+	extents.set(2, Px{50});
+	test.AssertEq(extents.offset(3), Px{70}, "Set did not update offsets");
+	test.AssertEq(extents.find(Px{69}), size_t{2}, "Set did not update lookups");
+	test.AssertEq(extents.find(Px{70}), size_t{3}, "Set did not update lookups");
+
+	// appended rows match a tree built at once
+	ExtentTree appended;
+	std::vector<float> values;
+	for (int i = 0; i < 37; ++i) {
+		values.push_back(float(1 + i % 5));
+		appended.push_back(Px{values.back()});
+	}
+	float sum = 0;
+	for (size_t i = 0; i <= values.size(); ++i) {
+		test.AssertEq(appended.offset(i), Px{sum}, "Appended offsets are wrong");
+		if (i < values.size()) {
+			sum += values[i];
+		}
+	}
+
+	appended.resize(5, Px{1});
+	test.AssertEq(appended.total(), Px{1 + 2 + 3 + 4 + 5}, "Shrinking kept rows");
+}
+
+TEST_CASE("Virtual list only materializes the window", VirtualListWindow) {
+	using namespace Klay;
+
+	std::vector<size_t> provided;
+	auto list_mode = std::make_unique<VirtualListLayoutMode>(Px{20});
+	auto& list = *list_mode;
+	list.SetItemCount(100'000);
+	list.scroll_offset = 1000;
+	list.overscan = 20;
+	list.provide_item = [&](size_t index) {
+		provided.push_back(index);
+		return ElementBuilder{}.MinHeight(Px{20}).Build();
+	};
+
+	auto root = ElementBuilder{}.LayoutMode(std::move(list_mode)).Build();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 300, 100));
+
+	// the window is [980, 1120), rows 49 to 56
+	test.AssertEq(list.GetFirstIndex(), size_t{49}, "Wrong first row");
+	test.AssertEq(list.GetEndIndex(), size_t{57}, "Wrong end row");
+	test.AssertEq(root->NumChildren(), size_t{8}, "Children should be the window");
+	test.AssertEq(provided.size(), size_t{8}, "Rows were provided more than once");
+	test.AssertEq(root->subtree_size, size_t{9}, "Subtree size should count the window");
+	test.AssertEq(
+		root->children[1]->ComputedRect(),
+		PxRect::FromXYWH(0, 0, 300, 20),
+		"Row 50 should be at the top of the viewport"
+	);
+
+	// scrolling reuses rows that stay in the window
+	provided.clear();
+	const auto row_55 = root->children[55 - 49];
+	list.scroll_offset = 1050;
+	root->MarkLayoutDirty();
+	test.Assert(!root->dirty_size, "Scrolling should not dirty the min size");
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 300, 100));
+	test.AssertEq(list.GetFirstIndex(), size_t{51}, "Wrong first row after scroll");
+	test.AssertEq(provided.size(), size_t{2}, "Only rows entering the window should be provided");
+	test.Assert(root->children[55 - 51] == row_55, "Row 55 was not reused");
+	test.AssertEq(
+		row_55->ComputedRect(),
+		PxRect::FromXYWH(0, 50, 300, 20),
+		"Row 55 has wrong layout"
+	);
+}
+
+TEST_CASE("Virtual list measures materialized rows", VirtualListMeasures) {
+	using namespace Klay;
+
+	auto list_mode = std::make_unique<VirtualListLayoutMode>(Px{10});
+	auto& list = *list_mode;
+	list.SetItemCount(1000);
+	// rows are taller than estimated, so fewer fit
+	list.provide_item = [](size_t index) {
+		return ElementBuilder{}.MinHeight(Px{index % 2 ? 30.0f : 20.0f}).Build();
+	};
+
+	auto root = ElementBuilder{}.LayoutMode(std::move(list_mode)).Build();
+	root->ComputeTreeLayout(PxRect::FromXYWH(0, 0, 100, 100));
+
+	test.AssertEq(list.GetFirstIndex(), size_t{0}, "Wrong first row");
+	test.AssertEq(list.GetEndIndex(), size_t{5}, "Window should shrink to the measured rows");
+	test.AssertEq(list.GetExtents().offset(4), Px{100}, "Measured extents were not stored");
+	// the first pass materialized rows 0 to 10 with the estimate,
+	// which all keep their measured extents
+	test.AssertEq(
+		list.GetContentExtent(),
+		Px{6 * 20 + 5 * 30 + 989 * 10},
+		"Unmeasured rows should keep the estimate"
+	);
+	test.AssertEq(
+		root->children[3]->ComputedRect(),
+		PxRect::FromXYWH(0, 70, 100, 30),
+		"Row 3 has wrong layout"
+	);
+}
@@ -24,6 +24,6 @@ void UnitTestFlex::OnResize(){
 
 void UnitTestFlex::Run(){
 	for(auto& child : root->children){
-		DrawElement(child, std::any_cast<Color>(child->user_data));
+		DrawElement(child, child->user_data.Get<Color>());
 	}
 }